@@ -0,0 +1,16 @@
+mkdir -p build/tools
+cc -O2 -o build/tools/assetpack tools/assetpack.c -lpng
+# sprite order must match BitmapIndices_t in src/room_gen.h
+build/tools/assetpack Source/sprites.atlas \
+    Source/floor00.png \
+    Source/floor01.png \
+    Source/floor02.png \
+    Source/floor03.png \
+    Source/wall.png \
+    Source/table.png \
+    Source/crate.png \
+    Source/doorh.png \
+    Source/doorv.png \
+    Source/player.png \
+    Source/npc.png \
+    Source/stairs.png
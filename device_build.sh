@@ -1,3 +1,4 @@
+bash ./assets_build.sh
 mkdir -p build
 cd build
 rm -rf device_cmake
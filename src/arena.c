@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include "arena.h"
+
+void arena_init(Arena_t *arena, const char *name, void *base, uint32_t capacity)
+{
+    arena->name = name;
+    arena->base = base;
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->high_water = 0;
+    arena->failed_allocs = 0;
+}
+
+void *arena_alloc(Arena_t *arena, uint32_t size)
+{
+    const uint32_t start = (arena->used + (ARENA_ALIGN - 1)) & ~(uint32_t)(ARENA_ALIGN - 1);
+
+    if (start > arena->capacity || size > arena->capacity - start)
+    {
+        arena->failed_allocs++;
+        return NULL;
+    }
+
+    arena->used = start + size;
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+
+    void *ptr = arena->base + start;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+uint32_t arena_mark(const Arena_t *arena)
+{
+    return arena->used;
+}
+
+void arena_release(Arena_t *arena, uint32_t mark)
+{
+    if (mark < arena->used) arena->used = mark;
+}
+
+void arena_reset(Arena_t *arena)
+{
+    arena->used = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+
+/**
+ * Fixed-size bump allocator over a caller supplied buffer.
+ * Kept free of any Playdate API so it can be shared with the host tools.
+ *
+ * Allocations are zeroed and 8 byte aligned, and are only ever freed in bulk:
+ * either everything at once (arena_reset) or back to a mark taken earlier (arena_release).
+ * A failed allocation returns NULL and is counted, the arena is left as it was.
+ **/
+
+#define ARENA_ALIGN (8)
+
+typedef struct Arena
+{
+    const char *name;
+    uint8_t *base;
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t high_water;
+    uint32_t failed_allocs;
+} Arena_t;
+
+void arena_init(Arena_t *arena, const char *name, void *base, uint32_t capacity);
+void *arena_alloc(Arena_t *arena, uint32_t size);
+uint32_t arena_mark(const Arena_t *arena);
+void arena_release(Arena_t *arena, uint32_t mark);
+void arena_reset(Arena_t *arena);
+
+#endif
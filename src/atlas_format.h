@@ -0,0 +1,46 @@
+#ifndef ATLAS_FORMAT_H
+#define ATLAS_FORMAT_H
+
+#include <stdint.h>
+
+/**
+ * Packed sprite atlas, produced at build time by tools/assetpack.c
+ * and loaded by the game with a single file read.
+ *
+ * Layout (little-endian):
+ *   AtlasHeader_t
+ *   AtlasEntry_t[header.count]
+ *   pixel data, referenced by entry offsets (relative to file start)
+ *
+ * Pixel rows are 1-bit, MSB first, tightly packed to rowbytes = ceil(width/8).
+ * Color bits follow the LCD convention (1 = white); mask bits are 1 for opaque.
+ **/
+
+#define ATLAS_MAGIC "MCAT"
+#define ATLAS_VERSION (1)
+#define ATLAS_FILENAME "sprites.atlas"
+
+typedef enum AtlasEntryFlags
+{
+    ATLASFLAG_NONE = 0x00,
+    ATLASFLAG_MASK = 0x01,
+} AtlasEntryFlags_t;
+
+typedef struct AtlasHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+} AtlasHeader_t;
+
+typedef struct AtlasEntry
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t rowbytes;
+    uint16_t flags;
+    uint32_t data_offset;
+    uint32_t mask_offset;
+} AtlasEntry_t;
+
+#endif
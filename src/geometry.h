@@ -0,0 +1,141 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <stdint.h>
+
+/**
+ * Tile, room and level geometry, shared by the game and the host tools.
+ *
+ * Room and level dimensions are powers of two, so with GEOMETRY_FAST_MATH enabled
+ * the index helpers below use shifts and masks, and the pixel to tile conversion
+ * uses a precomputed reciprocal multiply instead of dividing by TILE_SIZE_PX.
+ * Building with GEOMETRY_FAST_MATH=0 falls back to plain multiply/divide, for comparison.
+ * Both give identical results over the documented input range.
+ **/
+
+#ifndef GEOMETRY_FAST_MATH
+#define GEOMETRY_FAST_MATH (1)
+#endif
+
+#define TILE_SIZE_PX (40)
+#define TILE_OFFSET_PX (TILE_SIZE_PX / 2)
+#define TILE_COLL_PX (16)
+
+#define ROOM_WIDTH_SHIFT (4)
+#define ROOM_HEIGHT_SHIFT (4)
+#define ROOM_WIDTH (16)
+#define ROOM_HEIGHT (16)
+#define ROOM_MIN_X (0)
+#define ROOM_MIN_Y (0)
+#define ROOM_MAX_X (ROOM_WIDTH-1)
+#define ROOM_MAX_Y (ROOM_HEIGHT-1)
+
+#define ROOM_MID_X (ROOM_WIDTH/2)
+#define ROOM_MID_Y (ROOM_HEIGHT/2)
+
+#define LEVEL_WIDTH_SHIFT (8)
+#define LEVEL_WIDTH (256)
+#define LEVEL_HEIGHT (256)
+#define LEVEL_MIN_X (0)
+#define LEVEL_MIN_Y (0)
+#define LEVEL_MAX_X (LEVEL_WIDTH-1)
+#define LEVEL_MAX_Y (LEVEL_HEIGHT-1)
+
+#define ROOM_COUNT (LEVEL_WIDTH*LEVEL_HEIGHT)
+
+// largest pixel magnitude passed to the pixel to tile helpers: a few rooms either side of the current one
+#define GEOMETRY_PX_MAX (ROOM_WIDTH*TILE_SIZE_PX*4)
+
+// px / TILE_SIZE_PX == (px * TILE_DIV_MUL) >> TILE_DIV_SHIFT, exact for 0 <= px <= GEOMETRY_PX_MAX
+#define TILE_DIV_SHIFT (21)
+#define TILE_DIV_MUL ((((uint32_t)1 << TILE_DIV_SHIFT) + TILE_SIZE_PX - 1) / TILE_SIZE_PX)
+
+_Static_assert((1 << ROOM_WIDTH_SHIFT) == ROOM_WIDTH, "ROOM_WIDTH must be 1 << ROOM_WIDTH_SHIFT");
+_Static_assert((1 << ROOM_HEIGHT_SHIFT) == ROOM_HEIGHT, "ROOM_HEIGHT must be 1 << ROOM_HEIGHT_SHIFT");
+_Static_assert((1 << LEVEL_WIDTH_SHIFT) == LEVEL_WIDTH, "LEVEL_WIDTH must be 1 << LEVEL_WIDTH_SHIFT");
+_Static_assert(ROOM_COUNT <= 65536, "room indices must fit in 16 bits");
+_Static_assert(ROOM_WIDTH*TILE_SIZE_PX*2 <= INT16_MAX, "room pixel positions must fit packed 16 bit entities");
+_Static_assert((uint64_t)GEOMETRY_PX_MAX * TILE_DIV_MUL <= UINT32_MAX, "reciprocal divide must not overflow 32 bits");
+// the reciprocal's rounding error times the largest input must stay below one step of the shift
+_Static_assert(((uint64_t)TILE_DIV_MUL * TILE_SIZE_PX - ((uint64_t)1 << TILE_DIV_SHIFT)) * GEOMETRY_PX_MAX
+        < ((uint64_t)1 << TILE_DIV_SHIFT), "reciprocal divide isn't exact over GEOMETRY_PX_MAX");
+
+static inline int tile_idx(int tile_x, int tile_y)
+{
+#if GEOMETRY_FAST_MATH
+    return tile_x + (tile_y << ROOM_WIDTH_SHIFT);
+#else
+    return tile_x + (tile_y * ROOM_WIDTH);
+#endif
+}
+
+static inline int room_idx_at(int level_x, int level_y)
+{
+#if GEOMETRY_FAST_MATH
+    return level_x + (level_y << LEVEL_WIDTH_SHIFT);
+#else
+    return level_x + (level_y * LEVEL_WIDTH);
+#endif
+}
+
+static inline int room_idx_x(uint32_t room_idx)
+{
+#if GEOMETRY_FAST_MATH
+    return room_idx & (LEVEL_WIDTH-1);
+#else
+    return room_idx % LEVEL_WIDTH;
+#endif
+}
+
+static inline int room_idx_y(uint32_t room_idx)
+{
+#if GEOMETRY_FAST_MATH
+    return room_idx >> LEVEL_WIDTH_SHIFT;
+#else
+    return room_idx / LEVEL_WIDTH;
+#endif
+}
+
+// pixel to tile, truncating towards zero like px / TILE_SIZE_PX
+static inline int px_to_tile(int px)
+{
+#if GEOMETRY_FAST_MATH
+    return px >= 0 ? (int)(((uint32_t)px * TILE_DIV_MUL) >> TILE_DIV_SHIFT)
+                   : -(int)(((uint32_t)-px * TILE_DIV_MUL) >> TILE_DIV_SHIFT);
+#else
+    return px / TILE_SIZE_PX;
+#endif
+}
+
+// pixel to tile, rounding towards negative infinity
+static inline int px_to_tile_floor(int px)
+{
+#if GEOMETRY_FAST_MATH
+    return px >= 0 ? (int)(((uint32_t)px * TILE_DIV_MUL) >> TILE_DIV_SHIFT)
+                   : -(int)(((uint32_t)(TILE_SIZE_PX - 1 - px) * TILE_DIV_MUL) >> TILE_DIV_SHIFT);
+#else
+    return (px >= 0 ? px : px - (TILE_SIZE_PX - 1)) / TILE_SIZE_PX;
+#endif
+}
+
+// tile coordinate (relative to a room, possibly outside it) to room offset, rounding towards negative infinity
+static inline int tile_to_room_x(int tile_x)
+{
+#if GEOMETRY_FAST_MATH
+    // arithmetic right shift of negative values, which every supported compiler provides
+    return tile_x >> ROOM_WIDTH_SHIFT;
+#else
+    return (tile_x >= 0 ? tile_x : tile_x - (ROOM_WIDTH - 1)) / ROOM_WIDTH;
+#endif
+}
+
+static inline int tile_to_room_y(int tile_y)
+{
+#if GEOMETRY_FAST_MATH
+    return tile_y >> ROOM_HEIGHT_SHIFT;
+#else
+    return (tile_y >= 0 ? tile_y : tile_y - (ROOM_HEIGHT - 1)) / ROOM_HEIGHT;
+#endif
+}
+
+#endif
@@ -1,77 +1,132 @@
 #include "pd_api.h"
-
-#define TILE_SIZE_PX (40)
-#define TILE_OFFSET_PX (TILE_SIZE_PX / 2)
-#define TILE_COLL_PX (16)
+#include "arena.h"
+#include "atlas_format.h"
+#include "geometry.h"
+#include "replay_format.h"
+#include "room_gen.h"
+#include "trace.h"
 
 #define TEXT_WIDTH (86)
 #define TEXT_HEIGHT (16)
 
-#define LEVEL_WIDTH (16)
-#define LEVEL_HEIGHT (16)
-#define LEVEL_MIN_X (0)
-#define LEVEL_MIN_Y (0)
-#define LEVEL_MAX_X (LEVEL_WIDTH-1)
-#define LEVEL_MAX_Y (LEVEL_HEIGHT-1)
+#define HUD_POS_X (0)
+#define HUD_POS_Y (48)
+#define HUD_WIDTH (TEXT_WIDTH)
+// one text row per widget, HUD_WIDGET_COUNT is declared further down
+#define HUD_HEIGHT (TEXT_HEIGHT*HUD_WIDGET_COUNT)
+#define HUD_TEXT_MAX (32)
+
+// sparse room storage: only ROOM_CACHE_SIZE rooms are materialized at once,
+// the rest exist as their seed plus an optional entity delta
+#define ROOM_CACHE_SIZE (20)
+#define ROOM_DELTA_CAPACITY (1024)
+#define ROOM_DELTA_PROBE_MAX (8)
+#define ROOM_KEY_NONE (0xFFFFFFFF)
+#define ROOM_KEY(floor, room_idx) ((((uint32_t)(floor)) << 16) | (room_idx))
+#define ROOM_KEY_IDX(room_key) ((room_key) & 0xFFFF)
+#define ROOM_KEY_FLOOR(room_key) ((room_key) >> 16)
+#define LEVEL_START_ROOMS (9)
+
+// roughly one room in STAIRS_ROOM_RARITY leads down to the next floor
+#define STAIRS_ROOM_RARITY (12)
+
+// consecutive floors sharing a biome, and with it a room generator
+#define FLOORS_PER_BIOME (3)
+
+// minimap: visited rooms at one pixel per 2x2 tiles, so each room row packs into a single byte,
+// cached in a bitmap covering a window of rooms around the player
+#define MINIMAP_TILE_SHIFT (1)
+#define MINIMAP_ROOM_PX (ROOM_WIDTH >> MINIMAP_TILE_SHIFT)
+#define MINIMAP_WINDOW_ROOMS (12)
+#define MINIMAP_SIZE_PX (MINIMAP_ROOM_PX*MINIMAP_WINDOW_ROOMS)
+#define MINIMAP_EDGE_ROOMS (2)
+#define MINIMAP_SCREEN_MARGIN (8)
+#define MINIMAP_MARKER_PX (3)
+#define MINIMAP_THUMB_CAPACITY (1024)
+#define MINIMAP_THUMB_PROBE_MAX (8)
+
+// per-frame entity render queue, sized for every entity in the (at most 2x2) visible rooms plus their cones
+#define RENDER_QUEUE_MAX ((ENTITIES_LOCAL_MAX*2*4) + ENTITIES_GLOBAL_MAX)
+
+// when enabled the HUD shows last frame's draw counts
+#ifndef DEBUG_DRAW_STATS
+#define DEBUG_DRAW_STATS (0)
+#endif
+
+// when enabled, button and crank changes are timestamped and the time until the drawn player
+// and camera motion first responds is logged as a histogram every LATENCY_REPORT_INTERVAL inputs
+#ifndef LATENCY_PROBE
+#define LATENCY_PROBE (0)
+#endif
+
+// determinism checking: REPLAY_RECORD logs this run's seed and input, REPLAY_PLAY feeds a logged run back in,
+// and both write per-tick simulation hashes to compare with tools/hashdiff.c (see src/replay_format.h)
+#define REPLAY_OFF (0)
+#define REPLAY_RECORD (1)
+#define REPLAY_PLAY (2)
+#ifndef REPLAY_MODE
+#define REPLAY_MODE (REPLAY_OFF)
+#endif
 
-#define ROOM_COUNT (LEVEL_WIDTH*LEVEL_HEIGHT)
-#define ROOM_WIDTH (16)
-#define ROOM_HEIGHT (16)
-#define ROOM_MIN_X (0)
-#define ROOM_MIN_Y (0)
-#define ROOM_MAX_X (ROOM_WIDTH-1)
-#define ROOM_MAX_Y (ROOM_HEIGHT-1)
+#define LATENCY_BUCKET_MS (10)
+#define LATENCY_BUCKET_COUNT (12)
+#define LATENCY_TIMEOUT_FRAMES (25)
+#define LATENCY_REPORT_INTERVAL (32)
+#define LATENCY_STEP_EPSILON_PX (1)
+
+#define REFRESH_RATE_ACTIVE (50)
+#define REFRESH_RATE_IDLE (10)
+#define IDLE_FRAMES_BEFORE_THROTTLE (25)
+
+// accelerometer camera peek: tilt in fixed point g, dead zoned, low-passed, then only applied past a hysteresis step
+#define TILT_FX_SHIFT (12)
+#define TILT_DEAD_ZONE_FX (1 << (TILT_FX_SHIFT - 4))
+#define TILT_LOWPASS_DIVISOR (8)
+#define TILT_HYSTERESIS_PX (3)
+
+// when enabled, frames showing a static scene are skipped and the refresh rate drops while idle
+#ifndef ADAPTIVE_REFRESH
+#define ADAPTIVE_REFRESH (1)
+#endif
 
-#define ROOM_MID_X (ROOM_WIDTH/2)
-#define ROOM_MID_Y (ROOM_HEIGHT/2)
+// rewind history: one frame per simulated tick, stored as undo deltas with a periodic keyframe
+#define REWIND_BUFFER_BYTES (64*1024)
+#define REWIND_FRAME_MAX (1024)
+#define REWIND_FRAME_BYTES_MAX (2048)
+#define REWIND_KEYFRAME_INTERVAL (50)
+#define REWIND_ROOMS_MAX (8)
+#define REWIND_DEGREES_PER_TICK (6.0f)
+#define REWIND_GLOBAL_ROOM_IDX (0xFFFF)
+#define REWIND_ENTITY_BYTES (9)
+
+// memory regions carved out of one static block: persistent lives for the whole run,
+// level is cleared on every floor change and frame at the start of every update
+#define ARENA_PERSISTENT_BYTES (4*1024)
+#define ARENA_LEVEL_BYTES (112*1024)
+#define ARENA_FRAME_BYTES (16*1024)
+
+// positional sound effects, played on a fixed pool of synth voices created at boot
+#define SFX_VOICE_COUNT (6)
+#define SFX_RANGE_PX (ROOM_WIDTH*TILE_SIZE_PX)
+#define SFX_PAN_PX (200)
+#define SFX_MIN_VOLUME (0.02f)
+#define SFX_FOOTSTEPS_PER_TILE (2)
 
 #define ENTITIES_GLOBAL_MAX (16)
 #define ENTITIES_LOCAL_MAX (4)
-#define BITMAP_SIZE (419)
-#define BITMAP_COUNT (11)
-
-typedef enum CellType
-{
-    CELL_BORDER = -2,
-    CELL_CLOSED = -1,
-    CELL_PATH_0 = 0,
-    CELL_PATH_1 = 1,
-    CELL_PATH_2 = 2,
-    CELL_PATH_3 = 3,
-} CellType_t;
-
-typedef enum Direction
-{
-    DIR_NONE = -1,
-    DIR_LEFT = 0,
-    DIR_UP = 1,
-    DIR_RIGHT = 2,
-    DIR_DOWN = 3,
-    DIR_COUNT = 4,
-} Direction_t;
-
-typedef enum BitmapIndices
-{
-    BITMAP_FLOOR_00 = 0,
-    BITMAP_FLOOR_01 = 1,
-    BITMAP_FLOOR_02 = 2,
-    BITMAP_FLOOR_03 = 3,
-    BITMAP_WALL = 4,
-    BITMAP_TABLE = 5,
-    BITMAP_CRATE = 6,
-    BITMAP_DOOR_H = 7,
-    BITMAP_DOOR_V = 8,
-    BITMAP_PLAYER = 9,
-    BITMAP_NPC = 10,
-} BitmapIndices_t;
-
-typedef enum TileFlags
-{
-    TILEFLAG_NONE = 0x00,
-    TILEFLAG_WALKABLE = 0x01,
-    TILEFLAG_DOOR_H = 0x02,
-    TILEFLAG_DOOR_V = 0x04,
-} TileFlags_t;
+#define BITMAP_COUNT (12)
+#define BITMAP_MAX (64)
+
+// sprites drawn facing their entity's heading, their art faces left
+#define DIRECTIONAL_SPRITE_COUNT (2)
+
+typedef enum ArenaRegion
+{
+    ARENA_PERSISTENT = 0,
+    ARENA_LEVEL = 1,
+    ARENA_FRAME = 2,
+    ARENA_REGION_COUNT = 3,
+} ArenaRegion_t;
 
 typedef enum GamePhase
 {
@@ -81,11 +136,62 @@ typedef enum GamePhase
     PHASE_TERMINATING = 3,
 } GamePhase_t;
 
-typedef struct Vector2Int
+typedef enum RewindRecordType
+{
+    REWIND_REC_LOCAL = 0,
+    REWIND_REC_GLOBAL = 1,
+    REWIND_REC_ROOM = 2,
+    REWIND_REC_RNG = 3,
+} RewindRecordType_t;
+
+typedef enum HudWidgetIndices
+{
+    HUD_WIDGET_ROOM = 0,
+    HUD_WIDGET_FLOOR = 1,
+#if DEBUG_DRAW_STATS
+    HUD_WIDGET_DRAWS = 2,
+    HUD_WIDGET_COUNT = 3,
+#else
+    HUD_WIDGET_COUNT = 2,
+#endif
+} HudWidgetIndices_t;
+
+typedef enum RenderLayer
+{
+    RENDER_LAYER_SPRITES = 0,
+    RENDER_LAYER_CONES = 1,
+} RenderLayer_t;
+
+typedef enum RenderItemType
+{
+    RENDER_ITEM_SPRITE = 0,
+    RENDER_ITEM_CONE = 1,
+} RenderItemType_t;
+
+typedef enum LatencyTarget
+{
+    LATENCY_PLAYER = 0,
+    LATENCY_CAMERA = 1,
+    LATENCY_TARGET_COUNT = 2,
+} LatencyTarget_t;
+
+typedef enum SfxType
+{
+    SFX_FOOTSTEP = 0,
+    SFX_BOUNCE = 1,
+    SFX_DOOR = 2,
+    SFX_TYPE_COUNT = 3,
+} SfxType_t;
+
+typedef enum BootStage
 {
-    int x;
-    int y;
-} Vector2Int_t;
+    BOOT_FONT = 0,
+    BOOT_ATLAS = 1,
+    BOOT_LEVEL = 2,
+    BOOT_AUDIO = 3,
+    BOOT_CALIBRATE = 4,
+    BOOT_STAGE_COUNT = 5,
+} BootStage_t;
 
 typedef struct Vector2
 {
@@ -121,15 +227,20 @@ typedef struct GlobalEntity
     Entity_t entity;
 } GlobalEntity_t;
 
-typedef struct Tile
+typedef struct PackedEntity
 {
-    TileFlags_t flags;
-    int bitmap_idx;
-} Tile_t;
+    int16_t position_px[2];
+    int16_t mov_speed[2];
+    int8_t heading;
+    uint8_t bitmap_idx;
+} PackedEntity_t;
 
 typedef struct Room
 {
     Vector2Int_t coord;
+    Vector2Int_t spawn_px;
+    bool dirty;
+    bool has_stairs;
     Tile_t tiles[ROOM_WIDTH*ROOM_HEIGHT];
     uint8_t local_entity_count;
     Entity_t entities[ENTITIES_LOCAL_MAX];
@@ -141,13 +252,212 @@ typedef struct RoomDrawPositions
     int32_t y[ROOM_HEIGHT];
 } RoomDrawPositions_t;
 
+typedef struct RoomDelta
+{
+    uint32_t room_key;
+    uint32_t stamp;
+    uint8_t local_entity_count;
+    PackedEntity_t entities[ENTITIES_LOCAL_MAX];
+} RoomDelta_t;
+
+typedef struct MinimapThumb
+{
+    uint32_t room_key;
+    uint32_t stamp;
+    uint8_t rows[MINIMAP_ROOM_PX];
+} MinimapThumb_t;
+
 typedef struct Level
 {
-    Room_t rooms[LEVEL_WIDTH*LEVEL_HEIGHT];
+    uint32_t seed;
+    uint16_t floor;
+    uint32_t clock;
+    uint16_t start_room_idx;
+    uint32_t room_keys[ROOM_CACHE_SIZE];
+    uint32_t room_stamps[ROOM_CACHE_SIZE];
+    Room_t rooms[ROOM_CACHE_SIZE];
+    RoomDelta_t deltas[ROOM_DELTA_CAPACITY];
 } Level_t;
 
+typedef struct RewindFrame
+{
+    uint32_t offset;
+    uint16_t undo_size;
+    uint16_t key_size;
+} RewindFrame_t;
+
+typedef struct RewindCapture
+{
+    uint16_t room_idx;
+    uint8_t entity_count;
+    Entity_t entities[ENTITIES_LOCAL_MAX];
+} RewindCapture_t;
+
+typedef struct RewindState
+{
+    uint32_t tick;
+    uint32_t bytes_head;
+    uint32_t bytes_used;
+    uint16_t frame_first;
+    uint16_t frame_count;
+    float crank_accum;
+    uint16_t captured_current_room_idx;
+    Rng_t captured_ai_rng;
+    uint8_t captured_room_count;
+    RewindCapture_t captured_rooms[REWIND_ROOMS_MAX];
+    GlobalEntity_t captured_globals[ENTITIES_GLOBAL_MAX];
+    // level arena
+    uint8_t *scratch;
+    RewindFrame_t *frames;
+    uint8_t *buffer;
+} RewindState_t;
+
+typedef int (*HudFormatFunction)(char *buff, size_t buff_size, const int32_t values[2]);
+
+typedef struct HudWidgetInfo
+{
+    Vector2Int_t pos;
+    Vector2Int_t size;
+    HudFormatFunction format;
+} HudWidgetInfo_t;
+
+typedef struct HudWidget
+{
+    bool dirty;
+    int32_t values[2];
+    LCDBitmap *bitmap;
+} HudWidget_t;
+
+typedef struct HudState
+{
+    bool layer_dirty;
+    LCDBitmap *layer;
+    HudWidget_t widgets[HUD_WIDGET_COUNT];
+} HudState_t;
+
+typedef struct BootState
+{
+    BootStage_t stage;
+    uint16_t stage_cursor;
+    uint16_t stage_total;
+    uint16_t frames;
+    float elapsed;
+    float stage_times[BOOT_STAGE_COUNT];
+    uint16_t stage_frames[BOOT_STAGE_COUNT];
+    Vector2Int_t level_start;
+} BootState_t;
+
+typedef struct FloorPrefetch
+{
+    bool active;
+    uint16_t room_idx;
+    uint8_t cursor;
+} FloorPrefetch_t;
+
+typedef struct RenderItem
+{
+    uint32_t sort_key;
+    RenderItemType_t type;
+    int bitmap_idx;
+    Triangle2D_t shape;
+} RenderItem_t;
+
+typedef struct RenderStats
+{
+    uint16_t tiles;
+    uint16_t queued;
+    uint16_t culled;
+    uint16_t sprites;
+    uint16_t lines;
+} RenderStats_t;
+
+typedef struct RenderQueue
+{
+    uint16_t count;
+    // persistent arena
+    RenderItem_t *items;
+    RenderItem_t **sorted;
+    RenderStats_t stats;
+} RenderQueue_t;
+
+typedef struct MinimapState
+{
+    bool visible;
+    bool drawn_visible;
+    bool stale;
+    Vector2Int_t origin;
+    LCDBitmap *bitmap;
+    // level arena, a cache of what's been seen so it's dropped with the floor
+    MinimapThumb_t *thumbs;
+} MinimapState_t;
+
+typedef struct LatencyHistogram
+{
+    uint32_t count;
+    uint32_t missed;
+    uint32_t total_ms;
+    uint32_t max_ms;
+    uint32_t total_frames;
+    uint16_t buckets[LATENCY_BUCKET_COUNT];
+} LatencyHistogram_t;
+
+typedef struct LatencyProbe
+{
+    bool pending;
+    bool crank_moving;
+    // seconds from the input being read to now, minus the current frame's elapsed time
+    float elapsed;
+    uint16_t frames;
+    uint16_t probe_count;
+    bool responded[LATENCY_TARGET_COUNT];
+    Vector2Int_t baseline_step[LATENCY_TARGET_COUNT];
+    Vector2Int_t last_step[LATENCY_TARGET_COUNT];
+    Vector2Int_t last_drawn[LATENCY_TARGET_COUNT];
+    LatencyHistogram_t histograms[LATENCY_TARGET_COUNT];
+} LatencyProbe_t;
+
+typedef struct SfxInfo
+{
+    SoundWaveform waveform;
+    float attack;
+    float decay;
+    float sustain;
+    float release;
+    float frequency;
+    float length;
+    // a busy voice is only stolen for a sound of at least its priority
+    uint8_t priority;
+} SfxInfo_t;
+
+typedef struct SfxVoice
+{
+    PDSynth *synth;
+    uint8_t priority;
+    uint32_t started_us;
+    uint32_t ends_us;
+} SfxVoice_t;
+
+typedef struct SfxState
+{
+    SfxVoice_t voices[SFX_VOICE_COUNT];
+    uint32_t played;
+    uint32_t stolen;
+    uint32_t dropped;
+} SfxState_t;
+
+typedef struct ReplayState
+{
+    SDFile *input_file;
+    SDFile *hash_file;
+    uint32_t tick;
+    uint32_t generation_hash;
+} ReplayState_t;
+
 typedef struct SerializableState
 {
+    uint32_t world_seed;
+    // NPC decisions, kept apart from rand() so the whole simulation follows from the world seed
+    Rng_t ai_rng;
     uint16_t current_room_idx;
     Level_t level;
 
@@ -159,7 +469,10 @@ typedef struct SerializableState
 typedef struct EphemeralState
 {
     GamePhase_t phase;
+    BootState_t boot;
     float delta_time;
+    uint32_t frame_index;
+    uint32_t frame_start_us;
     Vector2Int_t screen_size;
     PDButtons buttons_current;
     PDButtons buttons_pushed;
@@ -170,34 +483,37 @@ typedef struct EphemeralState
     Vector2Int_t camera_offset_target;
     Vector2Int_t camera_offset;
     Vector2Int_t camera_peek_offset;
+    Vector2Int_t tilt_filtered_fx;
     GlobalEntity_t *player_ptr;
     Room_t *current_room_ptr;
     Room_t *adjacent_room_ptrs[4];
+    Room_t *visible_room_ptrs[4];
+    uint8_t visible_room_count;
+    Vector2Int_t drawn_camera_offset;
+    Vector2Int_t drawn_player_pos;
+    uint16_t idle_frames;
+    bool idle_throttled;
     RoomDrawPositions_t room_draw_positions;
+    HudState_t hud;
+    MinimapState_t minimap;
+    RenderQueue_t render;
+    RewindState_t rewind;
+    FloorPrefetch_t prefetch;
+    LatencyProbe_t latency;
+    ReplayState_t replay;
+    SfxState_t sfx;
     LCDFont* font;
-    uint8_t bitmaps_buffer[BITMAP_COUNT][BITMAP_SIZE];
-    LCDBitmap *bitmaps[BITMAP_COUNT];
+    uint16_t bitmap_count;
+    // directional sprite variants follow the atlas bitmaps, DIR_COUNT per directional sprite
+    uint16_t directional_first_idx;
+    LCDBitmap *bitmaps[BITMAP_MAX];
+    Arena_t arenas[ARENA_REGION_COUNT];
 } EphemeralState_t;
 
-PDSynth *synth = NULL;
 SoundSequence *sequence = NULL;
 
 static int game_update(void* userdata);
 
-static const char bitmap_paths[BITMAP_COUNT][16] =
-{
-    "floor00.png",
-    "floor01.png",
-    "floor02.png",
-    "floor03.png",
-    "wall.png",
-    "table.png",
-    "crate.png",
-    "doorh.png",
-    "doorv.png",
-    "player.png",
-    "npc.png",
-};
 static const char* fontpath = "/System/Fonts/Asheville-Sans-14-Bold.pft";
 static const int mov_accel_min = 15;
 static const int mov_accel_max = 30;
@@ -212,6 +528,11 @@ static const Vector2Int_t direction_vectors[4] =
     { .x = 1, .y = 0 },
     { .x = 0, .y = 1 },
 };
+static const PDButtons direction_buttons[4] = { kButtonLeft, kButtonUp, kButtonRight, kButtonDown };
+
+// indexed by slot in the directional variant table
+static const BitmapIndices_t directional_sprites[DIRECTIONAL_SPRITE_COUNT] = { BITMAP_PLAYER, BITMAP_NPC };
+
 static const Vector2Int_t direction_vectors_tile_px[4] =
 {
     { .x = -1*TILE_SIZE_PX, .y = 0 },
@@ -219,18 +540,32 @@ static const Vector2Int_t direction_vectors_tile_px[4] =
     { .x = 1*TILE_SIZE_PX, .y = 0 },
     { .x = 0, .y = 1*TILE_SIZE_PX },
 };
-static const Vector2Int_t adjacent_room_offsets[4] =
+
+// indexed by SfxType_t: waveform, attack, decay, sustain, release, frequency, length, priority
+static const SfxInfo_t sfx_infos[SFX_TYPE_COUNT] =
 {
-    {-(ROOM_WIDTH*TILE_SIZE_PX), 0},
-    {0, -(ROOM_HEIGHT*TILE_SIZE_PX)},
-    {+(ROOM_WIDTH*TILE_SIZE_PX), 0},
-    {0, +(ROOM_HEIGHT*TILE_SIZE_PX)},
+    { kWaveformNoise, 0.0f, 0.04f, 0.0f, 0.02f, 1200.0f, 0.05f, 0 },
+    { kWaveformTriangle, 0.0f, 0.10f, 0.0f, 0.05f, 90.0f, 0.12f, 1 },
+    { kWaveformSquare, 0.005f, 0.15f, 0.3f, 0.10f, 220.0f, 0.20f, 2 },
 };
 
+// worst case frame: every simulated entity changed on a keyframe tick, undo and snapshot records for each,
+// plus a room record (3 bytes) and an rng record (7 bytes) in both
+_Static_assert(2 * (3 + 7 + (ENTITIES_GLOBAL_MAX * (6 + REWIND_ENTITY_BYTES)) + (REWIND_ROOMS_MAX * ENTITIES_LOCAL_MAX * (4 + REWIND_ENTITY_BYTES)))
+        <= REWIND_FRAME_BYTES_MAX, "REWIND_FRAME_BYTES_MAX too small for a worst case rewind frame");
+_Static_assert((ROOM_WIDTH+1) * TILE_SIZE_PX * SFX_FOOTSTEPS_PER_TILE <= GEOMETRY_PX_MAX
+        && (ROOM_HEIGHT+1) * TILE_SIZE_PX * SFX_FOOTSTEPS_PER_TILE <= GEOMETRY_PX_MAX, "footstep strides must stay in the tile helpers' exact range");
+
+_Static_assert((ARENA_PERSISTENT_BYTES % ARENA_ALIGN) == 0 && (ARENA_LEVEL_BYTES % ARENA_ALIGN) == 0,
+        "arena regions must keep the next region aligned");
+
 static PlaydateAPI *pd_s = NULL;
 static SerializableState_t ser = {0};
 static EphemeralState_t eph = {0};
 
+// backing store for eph.arenas, uint64_t keeps it ARENA_ALIGN aligned
+static uint64_t arena_memory[(ARENA_PERSISTENT_BYTES + ARENA_LEVEL_BYTES + ARENA_FRAME_BYTES) / sizeof(uint64_t)];
+
 #ifdef _WINDLL
 __declspec(dllexport)
 #endif
@@ -240,430 +575,963 @@ static int8_t sign(int num)
     return (num > 0) - (num < 0);
 }
 
-static void set_current_room(uint16_t room_idx)
-{
-    pd_s->system->logToConsole("Setting current room to #%d.", room_idx);
-    ser.current_room_idx = room_idx;
-    eph.current_room_ptr = ser.level.rooms+room_idx;
-
-    eph.adjacent_room_ptrs[0] = eph.current_room_ptr->coord.x > LEVEL_MIN_X ? eph.current_room_ptr-1 : NULL;
-    eph.adjacent_room_ptrs[1] = eph.current_room_ptr->coord.y > LEVEL_MIN_Y ? eph.current_room_ptr-LEVEL_WIDTH : NULL;
-    eph.adjacent_room_ptrs[2] = eph.current_room_ptr->coord.x < LEVEL_MAX_X ? eph.current_room_ptr+1 : NULL;
-    eph.adjacent_room_ptrs[3] = eph.current_room_ptr->coord.y < LEVEL_MAX_Y ? eph.current_room_ptr+LEVEL_WIDTH : NULL;
-}
-
-static TileFlags_t tile_flags_at_pos(Room_t *room, int tile_x, int tile_y)
+static int clamp(int num, int min, int max)
 {
-    if (tile_x < ROOM_MIN_X || tile_x > ROOM_MAX_X
-     || tile_y < ROOM_MIN_Y || tile_y > ROOM_MAX_Y) return 0;
-    return room->tiles[tile_x + (tile_y * ROOM_WIDTH)].flags;
+    return num < min ? min : num > max ? max : num;
 }
 
-static bool generate_maze(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], const bool path_bools[4])
+/**
+ * Memory regions.
+ * Buffers that used to be fixed arrays or heap allocations come out of three arenas over one static block,
+ * and each region's high water mark is logged so the ARENA_*_BYTES budgets can be tuned from real runs.
+ **/
+static void arena_setup(void)
 {
-    // limiting a single walk to a sensible amount
-    // TODO: figure out possible implications
-    static const uint16_t walk_max_len = (ROOM_WIDTH*ROOM_HEIGHT);
+    static const char *names[ARENA_REGION_COUNT] = { "persistent", "level", "frame" };
+    static const uint32_t sizes[ARENA_REGION_COUNT] = { ARENA_PERSISTENT_BYTES, ARENA_LEVEL_BYTES, ARENA_FRAME_BYTES };
 
-    int first_path = rand() % 4;
+    uint8_t *base = (uint8_t *)arena_memory;
 
-    bool success = true;
-
-    int paths_connected[4] = { -1, -1, -1, -1, };
-
-    Vector2Int_t path_starts[4] =
+    for (uint8_t i = 0; i < ARENA_REGION_COUNT; i++)
     {
-        (Vector2Int_t){ROOM_MIN_X+1, ROOM_MID_Y},
-        (Vector2Int_t){ROOM_MID_X, ROOM_MIN_Y+1},
-        (Vector2Int_t){ROOM_MAX_X-1, ROOM_MID_Y},
-        (Vector2Int_t){ROOM_MID_X, ROOM_MAX_Y-1},
-    };
+        arena_init(eph.arenas+i, names[i], base, sizes[i]);
+        base += sizes[i];
+    }
+}
 
-    // 1. initialization
+static void *arena_alloc_region(ArenaRegion_t region, uint32_t size)
+{
+    Arena_t *arena = eph.arenas+region;
+    void *ptr = arena_alloc(arena, size);
 
-    // - first close every cell
-    for (uint16_t x = 0; x < ROOM_WIDTH; x++)
+    if (ptr == NULL)
     {
-        for (uint16_t y = 0; y < ROOM_HEIGHT; y++)
-        {
-            cell_grid[x][y] = CELL_CLOSED;
-        }
+        pd_s->system->logToConsole("!! %s arena exhausted: %u bytes requested with %u/%u used !!",
+                arena->name, (unsigned)size, (unsigned)arena->used, (unsigned)arena->capacity);
     }
 
-    // - set the bounding walls to BORDER so they don't get overriden
-    for (uint16_t x = 0; x < ROOM_WIDTH; x++)
-    {
-        cell_grid[x][ROOM_MIN_Y] = CELL_BORDER;
-        cell_grid[x][ROOM_MAX_Y] = CELL_BORDER;
-    }
+    return ptr;
+}
 
-    for (uint16_t y = 0; y < ROOM_HEIGHT; y++)
+static void arena_report(void)
+{
+    for (uint8_t i = 0; i < ARENA_REGION_COUNT; i++)
     {
-        cell_grid[ROOM_MIN_X][y] = CELL_BORDER;
-        cell_grid[ROOM_MAX_X][y] = CELL_BORDER;
+        const Arena_t *arena = eph.arenas+i;
+        pd_s->system->logToConsole("  %s memory: %u/%u bytes used, high water %u (%d%%), %u failed allocations.",
+                arena->name, (unsigned)arena->used, (unsigned)arena->capacity, (unsigned)arena->high_water,
+                (int)((arena->high_water * 100) / arena->capacity), (unsigned)arena->failed_allocs);
     }
+}
+
+// drops the previous floor's level allocations and hands out fresh (zeroed) ones for the next
+static void level_arena_reset(void)
+{
+    arena_reset(eph.arenas+ARENA_LEVEL);
+
+    eph.minimap.thumbs = arena_alloc_region(ARENA_LEVEL, sizeof(MinimapThumb_t) * MINIMAP_THUMB_CAPACITY);
+    eph.rewind.scratch = arena_alloc_region(ARENA_LEVEL, REWIND_FRAME_BYTES_MAX);
+    eph.rewind.frames = arena_alloc_region(ARENA_LEVEL, sizeof(RewindFrame_t) * REWIND_FRAME_MAX);
+    eph.rewind.buffer = arena_alloc_region(ARENA_LEVEL, REWIND_BUFFER_BYTES);
 
-    // - add random border tiles in the room interior to discourage the tendency towards 'open space'
-    uint8_t num_rand_border = rand() % ((ROOM_WIDTH+ROOM_HEIGHT)/8);
-    for (uint8_t i = 0; i < num_rand_border; i++)
+    if (eph.minimap.thumbs == NULL || eph.rewind.scratch == NULL || eph.rewind.frames == NULL || eph.rewind.buffer == NULL)
     {
-        cell_grid[rand() % ((ROOM_MIN_X+2)+((ROOM_MAX_X-ROOM_MIN_X)-2))][rand() % ((ROOM_MIN_Y+2)+((ROOM_MAX_Y-ROOM_MIN_Y)-2))] = CELL_BORDER;
+        pd_s->system->error("%s:%i Level memory budget of %d bytes is too small", __FILE__, __LINE__, ARENA_LEVEL_BYTES);
     }
+}
 
-    for (int path_num = 0; path_num < 4; path_num++)
-    {
-        CellType_t path_idx = (first_path + path_num) % 4;
+static Rng_t room_rng(uint32_t level_seed, uint16_t room_idx)
+{
+    Rng_t rng = { hash_u32(level_seed ^ hash_u32(room_idx + 1)) };
+    if (rng.state == 0) rng.state = 1;
+    return rng;
+}
 
-        if (!path_bools[path_idx]) continue;
+static void pack_entity(PackedEntity_t *packed, const Entity_t *entity)
+{
+    packed->position_px[0] = entity->position_px.x;
+    packed->position_px[1] = entity->position_px.y;
+    packed->mov_speed[0] = entity->mov_speed.x;
+    packed->mov_speed[1] = entity->mov_speed.y;
+    packed->heading = entity->heading;
+    packed->bitmap_idx = entity->bitmap_idx;
+}
 
-        cell_grid[path_starts[path_idx].x][path_starts[path_idx].y] = (CellType_t)path_idx;
-    }
+static void unpack_entity(Entity_t *entity, const PackedEntity_t *packed)
+{
+    entity->position_px.x = packed->position_px[0];
+    entity->position_px.y = packed->position_px[1];
+    entity->mov_speed.x = packed->mov_speed[0];
+    entity->mov_speed.y = packed->mov_speed[1];
+    entity->heading = packed->heading;
+    entity->bitmap_idx = packed->bitmap_idx;
+}
 
-    Vector2Int_t coord_stack[(ROOM_WIDTH*ROOM_HEIGHT)] = {0};
-    Direction_t move_stack[(ROOM_WIDTH*ROOM_HEIGHT)] = {0};
+static uint32_t floor_seed(uint16_t floor)
+{
+    return hash_u32(ser.world_seed ^ hash_u32(floor + 1));
+}
 
-    bool reverse_path_order = (rand() % 2) > 0;
+static bool room_has_stairs(uint32_t level_seed, uint16_t room_idx)
+{
+    return (hash_u32(level_seed + room_idx) % STAIRS_ROOM_RARITY) == 0;
+}
 
-    // four random walks, until all four paths are connected to a single maze.
-    for (CellType_t path_num = 0; path_num < 4; path_num++)
+static const RoomGenerator_t *floor_generator(uint16_t floor)
+{
+    // picked from tools/mazebench.c results: the cheap random walk up top,
+    // then the longer, twistier spanning tree and division mazes further down
+    static const RoomGeneratorIndices_t biome_generators[] =
     {
-        CellType_t path_idx = (first_path + path_num) % 4;
-        if (reverse_path_order) path_idx = CELL_PATH_3 - path_idx;
+        ROOMGEN_RANDOM_WALK,
+        ROOMGEN_DIVISION,
+        ROOMGEN_WILSON,
+    };
 
-        if (!path_bools[path_idx]) continue;
+    static const uint16_t biome_count = sizeof(biome_generators) / sizeof(biome_generators[0]);
 
-        int32_t walk_idx = 0;
-        // 2. start walk from pre-determined path start.
-        move_stack[0] = DIR_NONE;
-        coord_stack[0].x = path_starts[path_idx].x;
-        coord_stack[0].y = path_starts[path_idx].y;
+    return room_generators + biome_generators[(floor / FLOORS_PER_BIOME) % biome_count];
+}
 
-        // 3. walk and set cells 'open' until reaching either a foreign open cell (LINK), a self open cell (LOOP), or a DEAD END
-        while (walk_idx >= 0)
-        {
-            Vector2Int_t curr = coord_stack[walk_idx];
-            // - set current cell to current path index; we will change this to CLOSED if a loop is detected.
-            // - in either case, it is now marked as resolved and will not be checked again.
-            cell_grid[curr.x][curr.y] = (CellType_t)path_idx;
+static bool populate_room(Room_t *room, const RoomGenerator_t *generator, uint32_t level_seed, uint16_t level_x, uint16_t level_y, bool spawn_npc);
 
-            // - check valid directions from current cell
-            bool dirs_in_bounds[DIR_COUNT] =
-            {
-                curr.x > ROOM_MIN_X && move_stack[walk_idx] != DIR_RIGHT,
-                curr.y > ROOM_MIN_Y && move_stack[walk_idx] != DIR_DOWN,
-                curr.x < ROOM_MAX_X && move_stack[walk_idx] != DIR_LEFT,
-                curr.y < ROOM_MAX_Y && move_stack[walk_idx] != DIR_UP,
-            };
+/**
+ * Room deltas live in a fixed-size hash table probed linearly over a short window.
+ * When the window is full the stalest delta in it is overwritten, reverting that room to its seed state;
+ * this keeps the table at a constant size however much of the level is explored.
+ * Only the current floor has deltas, the table is cleared when changing floors.
+ **/
+static RoomDelta_t *room_delta_find(uint16_t room_idx, bool create)
+{
+    RoomDelta_t *oldest = NULL;
+    uint32_t bucket = hash_u32(room_idx) % ROOM_DELTA_CAPACITY;
 
-            CellType_t dirs_types[DIR_COUNT] =
-            {
-                dirs_in_bounds[DIR_LEFT]  ? cell_grid[curr.x-1][curr.y] : CELL_BORDER,
-                dirs_in_bounds[DIR_UP]    ? cell_grid[curr.x][curr.y-1] : CELL_BORDER,
-                dirs_in_bounds[DIR_RIGHT] ? cell_grid[curr.x+1][curr.y] : CELL_BORDER,
-                dirs_in_bounds[DIR_DOWN]  ? cell_grid[curr.x][curr.y+1] : CELL_BORDER,
-            };
+    for (uint8_t i = 0; i < ROOM_DELTA_PROBE_MAX; i++)
+    {
+        RoomDelta_t *delta = ser.level.deltas+((bucket + i) % ROOM_DELTA_CAPACITY);
 
-            Vector2Int_t dirs_coords[DIR_COUNT] =
-            {
-                dirs_in_bounds[DIR_LEFT]  ? (Vector2Int_t){curr.x-1, curr.y} : (Vector2Int_t){0, 0},
-                dirs_in_bounds[DIR_UP]    ? (Vector2Int_t){curr.x, curr.y-1} : (Vector2Int_t){0, 0},
-                dirs_in_bounds[DIR_RIGHT] ? (Vector2Int_t){curr.x+1, curr.y} : (Vector2Int_t){0, 0},
-                dirs_in_bounds[DIR_DOWN]  ? (Vector2Int_t){curr.x, curr.y+1} : (Vector2Int_t){0, 0},
-            };
+        if (delta->room_key == room_idx) return delta;
 
-            int dir_count = 0;
-            Direction_t dir_indices[DIR_COUNT] = {DIR_NONE};
+        if (delta->room_key == ROOM_KEY_NONE)
+        {
+            if (!create) return NULL;
+            oldest = delta;
+            break;
+        }
 
-            for (int i = DIR_LEFT; i < DIR_COUNT; i++)
-            {
-                if (!dirs_in_bounds[i]) continue;
+        if (oldest == NULL || delta->stamp < oldest->stamp) oldest = delta;
+    }
 
-                if (dirs_types[i] == (CellType_t)path_idx
-                || (dirs_types[i] >= 0 && paths_connected[dirs_types[i]] == path_idx))
-                {
-                    // ** LOOP **
-                    // skip it as if it were a border.
-                    //pd_s->system->logToConsole("Loop [%d,%d] reached in walk between [0][%d,%d] and [%d][%d,%d].",
-                    //    dirs_coords[i].x, dirs_coords[i].y, coord_stack[0].x, coord_stack[0].y, walk_idx, coord_stack[walk_idx].x, coord_stack[walk_idx].y);
-                    continue;
-                }
+    if (!create) return NULL;
 
-                switch(dirs_types[i])
-                {
-                    case CELL_CLOSED:
-                        // cell is unresolved, count and list it as option for next step
-                        dir_indices[dir_count] = i;
-                        dir_count++;
-                        break;
-                    case CELL_BORDER:
-                        // cell is not counted as an option
-                        continue;
-                    case CELL_PATH_0:
-                    case CELL_PATH_1:
-                    case CELL_PATH_2:
-                    case CELL_PATH_3:
-                        // ** LINK ** 
-                        //pd_s->system->logToConsole("Link [%d,%d] reached in walk between [0][%d,%d] and [%d][%d,%d].",
-                        //        dirs_coords[i].x, dirs_coords[i].y, coord_stack[0].x, coord_stack[0].y, walk_idx, coord_stack[walk_idx].x, coord_stack[walk_idx].y);
-                        // end walk
-                        paths_connected[path_idx] = false;
-                        paths_connected[dirs_types[i]] = true;
-                        walk_idx = -1;
-                        break;
-                }
+    oldest->room_key = room_idx;
+    oldest->local_entity_count = 0;
+    return oldest;
+}
 
-                if (walk_idx == -1) break;
-            }
+static void room_store_save(uint32_t room_key, Room_t *room)
+{
+    if (!room->dirty || ROOM_KEY_FLOOR(room_key) != ser.level.floor) return;
 
-            if (walk_idx == -1) continue;
+    RoomDelta_t *delta = room_delta_find(ROOM_KEY_IDX(room_key), true);
+    delta->stamp = ser.level.clock;
+    delta->local_entity_count = room->local_entity_count;
 
-            // check for dead end
-            if (dir_count == 0)
-            {
-                // ** DEAD END **
-                // backtrack one.
-                //pd_s->system->logToConsole("Dead end reached in walk between [0][%d,%d] and [%d][%d,%d].",
-                //    coord_stack[0].x, coord_stack[0].y, walk_idx, coord_stack[walk_idx].x, coord_stack[walk_idx].y);
-                walk_idx--;
-                continue;
-            }
+    for (uint8_t i = 0; i < room->local_entity_count; i++)
+    {
+        pack_entity(delta->entities+i, room->entities+i);
+    }
+}
 
-            // check if current walk exceeded allowed length;
-            // NOTE: this check must NEVER happen before the other stop conditions are tested.
-            if (walk_idx >= walk_max_len)
-            {
-                // ** WALK LIMIT REACHED **
-                // end walk.
-                //pd_s->system->logToConsole("Limit reached in walk between [0][%d,%d] and [%d][%d,%d].",
-                //    coord_stack[0].x, coord_stack[0].y, walk_idx, coord_stack[walk_idx].x, coord_stack[walk_idx].y);
-                walk_idx = -1;
-            }
+static Room_t *room_store_find(uint32_t room_key)
+{
+    for (uint8_t i = 0; i < ROOM_CACHE_SIZE; i++)
+    {
+        if (ser.level.room_keys[i] == room_key)
+        {
+            ser.level.room_stamps[i] = ++ser.level.clock;
+            return ser.level.rooms+i;
+        }
+    }
 
-            // ** WALK CONTINUES **
-            Direction_t chosen_dir = DIR_NONE;
+    return NULL;
+}
 
-            // if only one direction is valid, select it
-            if (dir_count == 1)
-            {
-                chosen_dir = dir_indices[0];
-            }
-            // else, select randomly from valid options
-            else
-            {
-                chosen_dir = dir_indices[rand() % dir_count];
-            }
+static bool room_key_near(uint32_t room_key, uint16_t floor, uint16_t room_idx)
+{
+    if (room_key == ROOM_KEY_NONE || ROOM_KEY_FLOOR(room_key) != floor) return false;
 
-            walk_idx++;
-            move_stack[walk_idx] = chosen_dir;
+    int dx = room_idx_x(ROOM_KEY_IDX(room_key)) - room_idx_x(room_idx);
+    int dy = room_idx_y(ROOM_KEY_IDX(room_key)) - room_idx_y(room_idx);
 
-            switch(chosen_dir)
-            {
-                case DIR_LEFT:
-                case DIR_UP:
-                case DIR_RIGHT:
-                case DIR_DOWN:
-                    coord_stack[walk_idx].x = dirs_coords[chosen_dir].x;
-                    coord_stack[walk_idx].y = dirs_coords[chosen_dir].y;
-                    break;
-                case DIR_NONE:
-                case DIR_COUNT:
-                  // should not happen, end walk.
-                  walk_idx = -1;
-                  pd_s->system->logToConsole("!! Invalid 'chosen direction' in maze generation !!");
-                  success = false;
-                  break;
-            }
-        }
-    }
+    return dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1;
+}
 
-    // 4. presumably all paths have now been linked and the caller can now use the maze grid.
-    return success;
+// rooms within one step (diagonals included) of the current room,
+// or of the next floor's arrival room while it's being prefetched, are never evicted
+static bool room_store_pinned(uint32_t room_key)
+{
+    if (eph.current_room_ptr != NULL
+     && room_key_near(room_key, ser.level.floor, room_idx_at(eph.current_room_ptr->coord.x, eph.current_room_ptr->coord.y))) return true;
+
+    return eph.prefetch.active && room_key_near(room_key, ser.level.floor+1, eph.prefetch.room_idx);
 }
 
-static bool populate_room(uint16_t level_x, uint16_t level_y, bool player_start)
+/**
+ * Returns the materialized room, regenerating it from its seed and reapplying its delta if needed.
+ * The least recently used unpinned room is evicted (saved back to delta form) to make space.
+ * Rooms of the next floor can be materialized ahead of time, their NPC spawn is skipped in the arrival room.
+ **/
+static Room_t *room_store_get_key(uint32_t room_key)
 {
-    static const uint8_t doorh_count = 2;
-    static const uint8_t doorv_count = 2;
+    Room_t *room = room_store_find(room_key);
+    if (room != NULL) return room;
 
-    static CellType_t maze_grid[ROOM_WIDTH][ROOM_HEIGHT] = {0};
+    int8_t slot = -1;
 
-    //pd_s->system->logToConsole("Populating room [%d,%d].", level_x, level_y);
+    for (uint8_t i = 0; i < ROOM_CACHE_SIZE; i++)
+    {
+        if (ser.level.room_keys[i] == ROOM_KEY_NONE)
+        {
+            slot = i;
+            break;
+        }
 
-    uint16_t level_idx = level_x + (level_y * LEVEL_WIDTH);
-    Room_t *room = ser.level.rooms + level_idx;
-    room->coord.x = level_x;
-    room->coord.y = level_y;
+        if (room_store_pinned(ser.level.room_keys[i])) continue;
+        if (slot < 0 || ser.level.room_stamps[i] < ser.level.room_stamps[slot]) slot = i;
+    }
 
-    Tile_t *tile = NULL;
-    bool placed_entity = false;
-    Vector2Int_t entity_coord = {0};
+    const uint16_t room_idx = ROOM_KEY_IDX(room_key);
+    const uint16_t floor = ROOM_KEY_FLOOR(room_key);
 
-    const bool door_bools[4] =
+    if (slot < 0)
     {
-        level_x > LEVEL_MIN_X,
-        level_y > LEVEL_MIN_Y,
-        level_x < LEVEL_MAX_X,
-        level_y < LEVEL_MAX_Y,
-    };
+        pd_s->system->error("%s:%i Room cache exhausted materializing room #%d", __FILE__, __LINE__, room_idx);
+        return NULL;
+    }
 
-    const int32_t doorh_indices[2] =
-    {
-        door_bools[0] ? ROOM_MIN_X + (ROOM_WIDTH*ROOM_MID_Y) : -1,
-        door_bools[2] ? ROOM_MAX_X + (ROOM_WIDTH*ROOM_MID_Y) : -1,
-    };
+    room = ser.level.rooms+slot;
+    if (ser.level.room_keys[slot] != ROOM_KEY_NONE) room_store_save(ser.level.room_keys[slot], room);
 
-    const int32_t doorv_indices[2] =
+    // generation relies on zero-as-default, so reused slots are cleared first
+    bzero(room, sizeof(Room_t));
+    ser.level.room_keys[slot] = room_key;
+    ser.level.room_stamps[slot] = ++ser.level.clock;
+
+    const bool current_floor = floor == ser.level.floor;
+    const uint16_t arrival_room_idx = current_floor ? ser.level.start_room_idx : eph.prefetch.room_idx;
+
+    if (!populate_room(room, floor_generator(floor), current_floor ? ser.level.seed : floor_seed(floor),
+                room_idx_x(room_idx), room_idx_y(room_idx), room_idx != arrival_room_idx))
     {
-        door_bools[1] ? ROOM_MID_X + (ROOM_WIDTH*ROOM_MIN_Y) : -1,
-        door_bools[3] ? ROOM_MID_X + (ROOM_WIDTH*ROOM_MAX_Y) : -1,
-    };
+        pd_s->system->logToConsole("!! Couldn't populate room #%d on floor %d !!", room_idx, floor);
+    }
 
-    bool maze_success = generate_maze(maze_grid, door_bools);
-    if (!maze_success) return false;
+    RoomDelta_t *delta = current_floor ? room_delta_find(room_idx, false) : NULL;
 
-    for (int x = 0; x < ROOM_WIDTH; x++)
+    if (delta != NULL)
     {
-        for (int y = 0; y < ROOM_HEIGHT; y++)
-        {
-            tile = room->tiles+(x + (ROOM_WIDTH * y));
-
-             /**
-             * All fields are expected to be zero-initialized and adhere to zero-as-default,
-             * which should have the same effect as if this code were here:
-             *
-             * tile->bitmap_idx = BITMAP_WALL;
-            * tile->flags = TILEFLAG_NONE;
-             *
-             * TODO: create room generation tests to enforce this assumption.
-             **/
-
-            uint8_t adj_space =
-            (x == (ROOM_MIN_X+1) || maze_grid[x-1][y] >= CELL_PATH_0)
-             + (x == (ROOM_MAX_X-1) || maze_grid[x+1][y] >= CELL_PATH_0)
-             + (y == (ROOM_MIN_Y+1) || maze_grid[x][y-1] >= CELL_PATH_0)
-             + (y == (ROOM_MAX_Y-1) || maze_grid[x][y+1] >= CELL_PATH_0);
-
-            switch(maze_grid[x][y])
-            {
-            case CELL_PATH_0:
-            case CELL_PATH_1:
-            case CELL_PATH_2:
-            case CELL_PATH_3:
-                tile->bitmap_idx = BITMAP_FLOOR_00 + maze_grid[x][y];
-                tile->flags |= TILEFLAG_WALKABLE;
-
-                if (!placed_entity || ((rand() % 100) > 80))
-                {
-                    entity_coord.x = x;
-                    entity_coord.y = y;
-                    placed_entity = true;
-                }
+        room->local_entity_count = delta->local_entity_count;
 
-                break;
-            case CELL_CLOSED:
-            case CELL_BORDER:
-                tile->bitmap_idx = adj_space >= 4 ? BITMAP_TABLE
-                    : adj_space >= 3 ? BITMAP_CRATE : BITMAP_WALL;
-                tile->flags = TILEFLAG_NONE;
-                break;
-            default:
-                pd_s->system->logToConsole("!! Unresolved cell in returned maze grid !!");
-                tile->bitmap_idx = BITMAP_PLAYER;
-                tile->flags = TILEFLAG_NONE;
-                // shouldn't happen
-                break;
-            }
+        for (uint8_t i = 0; i < delta->local_entity_count; i++)
+        {
+            unpack_entity(room->entities+i, delta->entities+i);
         }
+
+        room->dirty = true;
     }
 
-    for (uint8_t i = 0; i < doorh_count; i++)
+    return room;
+}
+
+static Room_t *room_store_get(uint16_t room_idx)
+{
+    return room_store_get_key(ROOM_KEY(ser.level.floor, room_idx));
+}
+
+static void room_store_reset(void)
+{
+    ser.level.clock = 0;
+
+    for (uint16_t i = 0; i < ROOM_CACHE_SIZE; i++)
     {
-        if (doorh_indices[i] < 0) continue;
-        room->tiles[doorh_indices[i]].bitmap_idx = BITMAP_DOOR_H;
-        room->tiles[doorh_indices[i]].flags |= (TILEFLAG_DOOR_H | TILEFLAG_WALKABLE);
+        ser.level.room_keys[i] = ROOM_KEY_NONE;
+        ser.level.room_stamps[i] = 0;
     }
+}
+
+/**
+ * Switches the store over to the given floor.
+ * Rooms already prefetched for it are kept, everything belonging to other floors is dropped,
+ * along with all deltas and minimap thumbnails since floors are never revisited.
+ **/
+static void room_store_set_floor(uint16_t floor, uint16_t start_room_idx)
+{
+    ser.level.floor = floor;
+    ser.level.seed = floor_seed(floor);
+    ser.level.start_room_idx = start_room_idx;
 
-    for (uint8_t i = 0; i < doorv_count; i++)
+    for (uint16_t i = 0; i < ROOM_CACHE_SIZE; i++)
     {
-        if (doorv_indices[i] < 0) continue;
-        room->tiles[doorv_indices[i]].bitmap_idx = BITMAP_DOOR_V;
-        room->tiles[doorv_indices[i]].flags |= (TILEFLAG_DOOR_V | TILEFLAG_WALKABLE);
+        if (ser.level.room_keys[i] != ROOM_KEY_NONE && ROOM_KEY_FLOOR(ser.level.room_keys[i]) == floor) continue;
+        ser.level.room_keys[i] = ROOM_KEY_NONE;
+        ser.level.room_stamps[i] = 0;
     }
 
-    if (player_start && eph.player_ptr != NULL)
+    for (uint16_t i = 0; i < ROOM_DELTA_CAPACITY; i++)
     {
-        if(eph.player_ptr != NULL)
-        {
-            // place player
-            uint16_t room_idx = level_x + (level_y * LEVEL_WIDTH);
-            eph.player_ptr->entity.position_px.x = entity_coord.x * TILE_SIZE_PX;
-            eph.player_ptr->entity.position_px.y = entity_coord.y * TILE_SIZE_PX;
-            eph.player_ptr->current_room_idx = room_idx;
-            set_current_room(room_idx);
-        }
+        ser.level.deltas[i].room_key = ROOM_KEY_NONE;
+        ser.level.deltas[i].stamp = 0;
     }
-    else
+
+    level_arena_reset();
+
+    for (uint16_t i = 0; i < MINIMAP_THUMB_CAPACITY; i++)
     {
-        room->entities[room->local_entity_count].bitmap_idx = BITMAP_NPC;
-        room->entities[room->local_entity_count].position_px.x = entity_coord.x * TILE_SIZE_PX; 
-        room->entities[room->local_entity_count].position_px.y = entity_coord.y * TILE_SIZE_PX; 
-        room->local_entity_count++;
+        eph.minimap.thumbs[i].room_key = ROOM_KEY_NONE;
     }
 
-    return true;
+    eph.minimap.stale = true;
 }
 
-bool populate_level(void)
+static Room_t *room_at_coord(int level_x, int level_y)
 {
-    pd_s->system->logToConsole("Initializing level.");
-    uint16_t start_x = rand() % LEVEL_WIDTH;
-    uint16_t start_y = rand() % LEVEL_HEIGHT;
+    if (level_x < LEVEL_MIN_X || level_x > LEVEL_MAX_X
+     || level_y < LEVEL_MIN_Y || level_y > LEVEL_MAX_Y) return NULL;
+    return room_store_get(room_idx_at(level_x, level_y));
+}
 
-    ser.player_entity_idx = ser.global_entity_count;
-    ser.global_entity_count++;
-    eph.player_ptr = ser.global_entities+ser.player_entity_idx;
-    eph.player_ptr->entity.bitmap_idx = BITMAP_PLAYER;
+static Room_t *room_at_idx(uint32_t room_idx)
+{
+    return room_idx < ROOM_COUNT ? room_store_get(room_idx) : NULL;
+}
+
+/**
+ * Visited rooms are kept as packed 8x8 thumbnails in a hash table laid out like the room deltas,
+ * so the minimap window can be redrawn after moving without regenerating any room.
+ **/
+static MinimapThumb_t *minimap_thumb_find(uint16_t room_idx, bool create)
+{
+    MinimapThumb_t *oldest = NULL;
+    uint32_t bucket = hash_u32(room_idx) % MINIMAP_THUMB_CAPACITY;
 
-    for (uint16_t x = 0; x < LEVEL_WIDTH; x++)
+    for (uint8_t i = 0; i < MINIMAP_THUMB_PROBE_MAX; i++)
     {
-        for (uint16_t y = 0; y < LEVEL_HEIGHT; y++)
+        MinimapThumb_t *thumb = eph.minimap.thumbs+((bucket + i) % MINIMAP_THUMB_CAPACITY);
+
+        if (thumb->room_key == room_idx) return thumb;
+
+        if (thumb->room_key == ROOM_KEY_NONE)
         {
-            bool room_success = populate_room(x, y, x == start_x && y == start_y);
-            if (!room_success) return false;
+            if (!create) return NULL;
+            oldest = thumb;
+            break;
         }
+
+        if (oldest == NULL || thumb->stamp < oldest->stamp) oldest = thumb;
     }
 
-    return true;
+    if (!create) return NULL;
+
+    oldest->room_key = room_idx;
+    return oldest;
 }
 
-static void prepare_room_draw_positions(void)
+// one bit per 2x2 tile block, set (white) if any tile in the block is walkable
+static void minimap_pack_room(const Room_t *room, uint8_t rows[MINIMAP_ROOM_PX])
 {
-    Vector2Int_t draw_pos_scratch = {-TILE_OFFSET_PX, -TILE_OFFSET_PX};
-
-    for (int x = 0; x < ROOM_WIDTH; x++)
+    for (uint8_t y = 0; y < MINIMAP_ROOM_PX; y++)
     {
-        draw_pos_scratch.x += TILE_SIZE_PX;
-        eph.room_draw_positions.x[x] = draw_pos_scratch.x;
+        rows[y] = 0;
+
+        for (uint8_t x = 0; x < MINIMAP_ROOM_PX; x++)
+        {
+            const Tile_t *tile = room->tiles+tile_idx(x*2, y*2);
+
+            if ((tile[0].flags | tile[1].flags | tile[ROOM_WIDTH].flags | tile[ROOM_WIDTH+1].flags) & TILEFLAG_WALKABLE)
+            {
+                rows[y] |= 0x80 >> x;
+            }
+        }
     }
+}
 
-    for (int y = 0; y < ROOM_HEIGHT; y++)
+// rooms are byte aligned in the minimap bitmap, so a thumbnail is copied in row by row
+static void minimap_blit(uint16_t room_idx, const uint8_t rows[MINIMAP_ROOM_PX])
+{
+    const int window_x = room_idx_x(room_idx) - eph.minimap.origin.x;
+    const int window_y = room_idx_y(room_idx) - eph.minimap.origin.y;
+
+    if (window_x < 0 || window_x >= MINIMAP_WINDOW_ROOMS
+     || window_y < 0 || window_y >= MINIMAP_WINDOW_ROOMS) return;
+
+    int rowbytes = 0;
+    uint8_t *data = NULL;
+    pd_s->graphics->getBitmapData(eph.minimap.bitmap, NULL, NULL, &rowbytes, NULL, &data);
+
+    for (uint8_t y = 0; y < MINIMAP_ROOM_PX; y++)
     {
-        draw_pos_scratch.y += TILE_SIZE_PX;
-        eph.room_draw_positions.y[y] = draw_pos_scratch.y;
+        data[(((window_y * MINIMAP_ROOM_PX) + y) * rowbytes) + window_x] = rows[y];
     }
 }
 
-static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_ptr, Room_t *room_ptr, Vector2Int_t target_speed, int accel)
+static void minimap_redraw(void)
 {
-    if (entity_ptr->mov_speed.x < target_speed.x)
+    int rowbytes = 0;
+    uint8_t *data = NULL;
+    pd_s->graphics->getBitmapData(eph.minimap.bitmap, NULL, NULL, &rowbytes, NULL, &data);
+    memset(data, 0, rowbytes * MINIMAP_SIZE_PX);
+
+    for (uint8_t y = 0; y < MINIMAP_WINDOW_ROOMS; y++)
     {
-        entity_ptr->mov_speed.x += accel;
-        if (entity_ptr->mov_speed.x > target_speed.x) entity_ptr->mov_speed.x = target_speed.x;
+        for (uint8_t x = 0; x < MINIMAP_WINDOW_ROOMS; x++)
+        {
+            const uint16_t room_idx = room_idx_at(eph.minimap.origin.x + x, eph.minimap.origin.y + y);
+            const MinimapThumb_t *thumb = minimap_thumb_find(room_idx, false);
+            if (thumb != NULL) minimap_blit(room_idx, thumb->rows);
+        }
     }
-    else if (entity_ptr->mov_speed.x > target_speed.x)
-    {
-        entity_ptr->mov_speed.x -= accel;
-        if (entity_ptr->mov_speed.x < target_speed.x) entity_ptr->mov_speed.x = target_speed.x;
+
+    eph.minimap.stale = false;
+}
+
+/**
+ * Records a room as visited. Only a newly visited room is drawn into the cached minimap,
+ * the whole window is redrawn only when it has to move to keep the room away from its edges.
+ **/
+static void minimap_visit(const Room_t *room)
+{
+    const uint16_t room_idx = room_idx_at(room->coord.x, room->coord.y);
+    MinimapThumb_t *thumb = minimap_thumb_find(room_idx, false);
+    const bool is_new = thumb == NULL;
+
+    if (is_new)
+    {
+        thumb = minimap_thumb_find(room_idx, true);
+        minimap_pack_room(room, thumb->rows);
+    }
+
+    thumb->stamp = ser.level.clock;
+
+    if (eph.minimap.bitmap == NULL)
+    {
+        eph.minimap.stale = true;
+        return;
+    }
+
+    const Vector2Int_t window_pos = { room->coord.x - eph.minimap.origin.x, room->coord.y - eph.minimap.origin.y };
+    const Vector2Int_t centered_origin =
+    {
+        clamp(room->coord.x - (MINIMAP_WINDOW_ROOMS / 2), LEVEL_MIN_X, LEVEL_WIDTH - MINIMAP_WINDOW_ROOMS),
+        clamp(room->coord.y - (MINIMAP_WINDOW_ROOMS / 2), LEVEL_MIN_Y, LEVEL_HEIGHT - MINIMAP_WINDOW_ROOMS),
+    };
+
+    const bool near_edge = window_pos.x < MINIMAP_EDGE_ROOMS || window_pos.x >= MINIMAP_WINDOW_ROOMS - MINIMAP_EDGE_ROOMS
+                        || window_pos.y < MINIMAP_EDGE_ROOMS || window_pos.y >= MINIMAP_WINDOW_ROOMS - MINIMAP_EDGE_ROOMS;
+
+    if (eph.minimap.stale
+     || (near_edge && (centered_origin.x != eph.minimap.origin.x || centered_origin.y != eph.minimap.origin.y)))
+    {
+        eph.minimap.origin = centered_origin;
+        minimap_redraw();
+    }
+    else if (is_new)
+    {
+        minimap_blit(room_idx, thumb->rows);
+    }
+}
+
+static void set_current_room(uint16_t room_idx)
+{
+    pd_s->system->logToConsole("Setting current room to #%d.", room_idx);
+    TRACE(TRACE_LEVEL_FRAME, TRACE_ROOM_ENTERED, room_idx, ser.level.floor);
+    ser.current_room_idx = room_idx;
+    eph.current_room_ptr = room_store_get(room_idx);
+
+    const Vector2Int_t coord = eph.current_room_ptr->coord;
+
+    eph.adjacent_room_ptrs[0] = room_at_coord(coord.x-1, coord.y);
+    eph.adjacent_room_ptrs[1] = room_at_coord(coord.x, coord.y-1);
+    eph.adjacent_room_ptrs[2] = room_at_coord(coord.x+1, coord.y);
+    eph.adjacent_room_ptrs[3] = room_at_coord(coord.x, coord.y+1);
+
+    // diagonal neighbours can be on screen too, make sure they're resident before drawing
+    room_at_coord(coord.x-1, coord.y-1);
+    room_at_coord(coord.x+1, coord.y-1);
+    room_at_coord(coord.x-1, coord.y+1);
+    room_at_coord(coord.x+1, coord.y+1);
+
+    minimap_visit(eph.current_room_ptr);
+}
+
+static TileFlags_t tile_flags_at_pos(Room_t *room, int tile_x, int tile_y)
+{
+    if (tile_x < ROOM_MIN_X || tile_x > ROOM_MAX_X
+     || tile_y < ROOM_MIN_Y || tile_y > ROOM_MAX_Y) return 0;
+    return room->tiles[tile_idx(tile_x, tile_y)].flags;
+}
+
+#if REPLAY_MODE != REPLAY_OFF
+/**
+ * Determinism hashes.
+ * Every gameplay tick the simulation state is hashed per subsystem, from individual fields rather than raw
+ * struct bytes so padding can't differ between builds. Tiles are only hashed once, as each room is generated,
+ * into a running hash, which keeps the per-tick cost to entities, deltas and a few scalars.
+ **/
+static uint32_t hash_word(uint32_t hash, uint32_t value)
+{
+    // FNV-1a over whole words
+    return (hash ^ value) * 0x01000193;
+}
+
+static uint32_t hash_entity(uint32_t hash, const Entity_t *entity)
+{
+    hash = hash_word(hash, entity->position_px.x);
+    hash = hash_word(hash, entity->position_px.y);
+    hash = hash_word(hash, entity->mov_speed.x);
+    hash = hash_word(hash, entity->mov_speed.y);
+    hash = hash_word(hash, entity->heading);
+    return hash_word(hash, entity->bitmap_idx);
+}
+
+static void replay_hash_generated_room(const Room_t *room)
+{
+    uint32_t hash = eph.replay.generation_hash;
+
+    hash = hash_word(hash, room_idx_at(room->coord.x, room->coord.y));
+    hash = hash_word(hash, room->has_stairs);
+    hash = hash_word(hash, room->spawn_px.x);
+    hash = hash_word(hash, room->spawn_px.y);
+
+    for (uint16_t i = 0; i < ROOM_WIDTH*ROOM_HEIGHT; i++)
+    {
+        hash = hash_word(hash, room->tiles[i].flags | (room->tiles[i].bitmap_idx << 8));
+    }
+
+    for (uint8_t i = 0; i < room->local_entity_count; i++)
+    {
+        hash = hash_entity(hash, room->entities+i);
+    }
+
+    eph.replay.generation_hash = hash;
+}
+
+static SDFile *replay_open_file(const char *path, FileOptions mode)
+{
+    SDFile *file = pd_s->file->open(path, mode);
+    if (file == NULL) pd_s->system->error("%s:%i Couldn't open %s: %s", __FILE__, __LINE__, path, pd_s->file->geterr());
+    return file;
+}
+
+// opens the replay files, when playing back the run's seed comes from the input log
+static void replay_open(uint32_t *seed)
+{
+    const ReplayHashHeader_t hash_header = { REPLAY_HASH_MAGIC, REPLAY_VERSION, HASH_SUBSYSTEM_COUNT };
+    ReplayInputHeader_t input_header = { REPLAY_INPUT_MAGIC, REPLAY_VERSION, sizeof(ReplayInputFrame_t), *seed };
+
+#if REPLAY_MODE == REPLAY_RECORD
+    eph.replay.input_file = replay_open_file(REPLAY_INPUT_FILENAME, kFileWrite);
+    eph.replay.hash_file = replay_open_file(REPLAY_HASH_RECORD_FILENAME, kFileWrite);
+    if (eph.replay.input_file == NULL || eph.replay.hash_file == NULL) return;
+
+    pd_s->file->write(eph.replay.input_file, &input_header, sizeof(input_header));
+#else
+    eph.replay.input_file = replay_open_file(REPLAY_INPUT_FILENAME, kFileRead);
+    eph.replay.hash_file = replay_open_file(REPLAY_HASH_PLAY_FILENAME, kFileWrite);
+    if (eph.replay.input_file == NULL || eph.replay.hash_file == NULL) return;
+
+    if (pd_s->file->read(eph.replay.input_file, &input_header, sizeof(input_header)) != sizeof(input_header)
+     || memcmp(input_header.magic, REPLAY_INPUT_MAGIC, sizeof(input_header.magic)) != 0
+     || input_header.version != REPLAY_VERSION || input_header.frame_size != sizeof(ReplayInputFrame_t))
+    {
+        pd_s->system->error("%s:%i %s isn't a version %d input log", __FILE__, __LINE__, REPLAY_INPUT_FILENAME, REPLAY_VERSION);
+        return;
+    }
+
+    *seed = input_header.seed;
+#endif
+
+    pd_s->file->write(eph.replay.hash_file, &hash_header, sizeof(hash_header));
+    pd_s->system->logToConsole("Replay %s from seed %u.", REPLAY_MODE == REPLAY_RECORD ? "recording" : "playing back", (unsigned)*seed);
+}
+
+static void replay_close(void)
+{
+    if (eph.replay.input_file != NULL) pd_s->file->close(eph.replay.input_file);
+    if (eph.replay.hash_file != NULL) pd_s->file->close(eph.replay.hash_file);
+
+    eph.replay.input_file = NULL;
+    eph.replay.hash_file = NULL;
+}
+
+#if REPLAY_MODE == REPLAY_RECORD
+static void replay_write_input(void)
+{
+    const ReplayInputFrame_t frame =
+    {
+        .delta_time = eph.delta_time,
+        .crank_angle = eph.crank.x,
+        .crank_change = eph.crank.y,
+        .accelerometer = { eph.accelerometer_raw.x, eph.accelerometer_raw.y, eph.accelerometer_raw.z },
+        .buttons = eph.buttons_current,
+        .crank_docked = eph.minimap.visible,
+    };
+
+    if (eph.replay.input_file != NULL) pd_s->file->write(eph.replay.input_file, &frame, sizeof(frame));
+}
+#else
+// replaces this tick's input and frame time with the logged ones, false once the log runs out
+static bool replay_read_input(void)
+{
+    ReplayInputFrame_t frame = {0};
+
+    if (eph.replay.input_file == NULL
+     || pd_s->file->read(eph.replay.input_file, &frame, sizeof(frame)) != sizeof(frame)) return false;
+
+    const PDButtons previous = eph.buttons_current;
+
+    eph.delta_time = frame.delta_time;
+    eph.crank.x = frame.crank_angle;
+    eph.crank.y = frame.crank_change;
+    eph.accelerometer_raw = (Vector3_t){ frame.accelerometer[0], frame.accelerometer[1], frame.accelerometer[2] };
+    eph.buttons_current = frame.buttons;
+    eph.buttons_pushed = frame.buttons & ~previous;
+    eph.buttons_released = previous & ~frame.buttons;
+    eph.minimap.visible = frame.crank_docked;
+
+    return true;
+}
+#endif
+
+static void replay_hash_tick(void)
+{
+    ReplayHashRecord_t record = { .tick = eph.replay.tick++ };
+    uint32_t hash = 0;
+
+    hash = hash_word(0x811C9DC5, ser.world_seed);
+    hash = hash_word(hash, ser.ai_rng.state);
+    hash = hash_word(hash, ser.current_room_idx);
+    hash = hash_word(hash, ser.level.seed);
+    hash = hash_word(hash, ser.level.floor);
+    hash = hash_word(hash, ser.level.clock);
+    record.hashes[HASH_LEVEL] = hash_word(hash, ser.level.start_room_idx);
+
+    hash = hash_word(0x811C9DC5, ser.global_entity_count);
+    hash = hash_word(hash, ser.player_entity_idx);
+
+    for (uint8_t i = 0; i < ser.global_entity_count; i++)
+    {
+        hash = hash_word(hash, ser.global_entities[i].current_room_idx);
+        hash = hash_entity(hash, &ser.global_entities[i].entity);
+    }
+
+    record.hashes[HASH_GLOBALS] = hash;
+
+    hash = 0x811C9DC5;
+
+    for (uint16_t i = 0; i < ROOM_CACHE_SIZE; i++)
+    {
+        const Room_t *room = ser.level.rooms+i;
+        if (ser.level.room_keys[i] == ROOM_KEY_NONE) continue;
+
+        hash = hash_word(hash, ser.level.room_keys[i]);
+        hash = hash_word(hash, room->dirty);
+
+        for (uint8_t j = 0; j < room->local_entity_count; j++)
+        {
+            hash = hash_entity(hash, room->entities+j);
+        }
+    }
+
+    for (uint16_t i = 0; i < ROOM_DELTA_CAPACITY; i++)
+    {
+        const RoomDelta_t *delta = ser.level.deltas+i;
+        if (delta->room_key == ROOM_KEY_NONE) continue;
+
+        hash = hash_word(hash, delta->room_key);
+        hash = hash_word(hash, delta->local_entity_count);
+
+        for (uint8_t j = 0; j < delta->local_entity_count; j++)
+        {
+            const PackedEntity_t *packed = delta->entities+j;
+            hash = hash_word(hash, (uint16_t)packed->position_px[0] | ((uint32_t)(uint16_t)packed->position_px[1] << 16));
+            hash = hash_word(hash, (uint16_t)packed->mov_speed[0] | ((uint32_t)(uint16_t)packed->mov_speed[1] << 16));
+            hash = hash_word(hash, (uint8_t)packed->heading | (packed->bitmap_idx << 8));
+        }
+    }
+
+    record.hashes[HASH_ROOMS] = hash;
+    record.hashes[HASH_GENERATION] = eph.replay.generation_hash;
+
+    if (eph.replay.hash_file != NULL) pd_s->file->write(eph.replay.hash_file, &record, sizeof(record));
+}
+#endif
+
+static bool populate_room(Room_t *room, const RoomGenerator_t *generator, uint32_t level_seed, uint16_t level_x, uint16_t level_y, bool spawn_npc)
+{
+    Arena_t *scratch = eph.arenas+ARENA_FRAME;
+
+#if TRACE_LEVEL > 0
+    const uint32_t trace_start_us = trace_now();
+#endif
+
+    uint16_t level_idx = room_idx_at(level_x, level_y);
+    Rng_t rng = room_rng(level_seed, level_idx);
+    room->coord.x = level_x;
+    room->coord.y = level_y;
+
+    Tile_t *tile = NULL;
+    bool placed_entity = false;
+    Vector2Int_t entity_coord = {0};
+
+    const bool door_bools[4] =
+    {
+        level_x > LEVEL_MIN_X,
+        level_y > LEVEL_MIN_Y,
+        level_x < LEVEL_MAX_X,
+        level_y < LEVEL_MAX_Y,
+    };
+
+    // the grid and the generator's working memory are only needed until the tiles are built
+    const uint32_t scratch_mark = arena_mark(scratch);
+    CellType_t (*maze_grid)[ROOM_HEIGHT] = arena_alloc_region(ARENA_FRAME, sizeof(CellType_t[ROOM_WIDTH][ROOM_HEIGHT]));
+    if (maze_grid == NULL) return false;
+
+    bool maze_success = generator->generate(rng_next(&rng), door_bools, maze_grid, scratch);
+
+    if (maze_success && !build_room_tiles(maze_grid, door_bools, room->tiles))
+    {
+        pd_s->system->logToConsole("!! Unresolved cell in returned maze grid !!");
+    }
+
+    arena_release(scratch, scratch_mark);
+    if (!maze_success) return false;
+
+    // the spawn point is a random plain floor tile, doors excluded
+    for (int x = 0; x < ROOM_WIDTH; x++)
+    {
+        for (int y = 0; y < ROOM_HEIGHT; y++)
+        {
+            tile = room->tiles+tile_idx(x, y);
+
+            if (tile->flags != TILEFLAG_WALKABLE) continue;
+
+            if (!placed_entity || ((rng_next(&rng) % 100) > 80))
+            {
+                entity_coord.x = x;
+                entity_coord.y = y;
+                placed_entity = true;
+            }
+        }
+    }
+
+    room->spawn_px.x = entity_coord.x * TILE_SIZE_PX;
+    room->spawn_px.y = entity_coord.y * TILE_SIZE_PX;
+
+    if (room_has_stairs(level_seed, level_idx))
+    {
+        // scan from a random tile for a plain walkable one, never the spawn point
+        uint16_t scan_start = rng_next(&rng) % (ROOM_WIDTH*ROOM_HEIGHT);
+
+        for (uint16_t i = 0; i < (ROOM_WIDTH*ROOM_HEIGHT); i++)
+        {
+            uint16_t scan_idx = (scan_start + i) % (ROOM_WIDTH*ROOM_HEIGHT);
+            tile = room->tiles+scan_idx;
+
+            if (tile->flags != TILEFLAG_WALKABLE) continue;
+            if (scan_idx == tile_idx(entity_coord.x, entity_coord.y)) continue;
+
+            tile->bitmap_idx = BITMAP_STAIRS;
+            tile->flags |= TILEFLAG_STAIRS;
+            room->has_stairs = true;
+            break;
+        }
+    }
+
+    // the player takes the arrival room's spawn point instead of an NPC
+    if (spawn_npc)
+    {
+        room->entities[room->local_entity_count].bitmap_idx = BITMAP_NPC;
+        room->entities[room->local_entity_count].position_px.x = entity_coord.x * TILE_SIZE_PX; 
+        room->entities[room->local_entity_count].position_px.y = entity_coord.y * TILE_SIZE_PX; 
+        room->local_entity_count++;
+    }
+
+    TRACE(TRACE_LEVEL_FRAME, TRACE_ROOM_GENERATED, level_idx, trace_now() - trace_start_us);
+
+#if REPLAY_MODE != REPLAY_OFF
+    replay_hash_generated_room(room);
+#endif
+
+    return true;
+}
+
+static void populate_level_begin(Vector2Int_t *start_coord)
+{
+    pd_s->system->logToConsole("Initializing level.");
+    start_coord->x = rand() % LEVEL_WIDTH;
+    start_coord->y = rand() % LEVEL_HEIGHT;
+
+    ser.world_seed = rand();
+    ser.ai_rng.state = hash_u32(~ser.world_seed) | 1;
+    room_store_reset();
+    room_store_set_floor(0, room_idx_at(start_coord->x, start_coord->y));
+
+    ser.player_entity_idx = ser.global_entity_count;
+    ser.global_entity_count++;
+    eph.player_ptr = ser.global_entities+ser.player_entity_idx;
+    eph.player_ptr->entity.bitmap_idx = BITMAP_PLAYER;
+}
+
+// materializes one room of the 3x3 start neighbourhood per call
+static bool populate_level_step(uint16_t room_num, Vector2Int_t start_coord)
+{
+    Vector2Int_t coord = { start_coord.x + (room_num % 3) - 1, start_coord.y + (room_num / 3) - 1 };
+
+    if (coord.x < LEVEL_MIN_X || coord.x > LEVEL_MAX_X
+     || coord.y < LEVEL_MIN_Y || coord.y > LEVEL_MAX_Y) return true;
+
+    return room_at_coord(coord.x, coord.y) != NULL;
+}
+
+static void populate_level_finish(void)
+{
+    Room_t *room = room_store_get(ser.level.start_room_idx);
+
+    eph.player_ptr->entity.position_px = room->spawn_px;
+    eph.player_ptr->current_room_idx = ser.level.start_room_idx;
+    set_current_room(ser.level.start_room_idx);
+}
+
+static void prepare_room_draw_positions(void)
+{
+    Vector2Int_t draw_pos_scratch = {-TILE_OFFSET_PX, -TILE_OFFSET_PX};
+
+    for (int x = 0; x < ROOM_WIDTH; x++)
+    {
+        draw_pos_scratch.x += TILE_SIZE_PX;
+        eph.room_draw_positions.x[x] = draw_pos_scratch.x;
+    }
+
+    for (int y = 0; y < ROOM_HEIGHT; y++)
+    {
+        draw_pos_scratch.y += TILE_SIZE_PX;
+        eph.room_draw_positions.y[y] = draw_pos_scratch.y;
+    }
+}
+
+static void sfx_init(void)
+{
+    for (int i = 0; i < SFX_VOICE_COUNT; i++)
+    {
+        eph.sfx.voices[i].synth = pd_s->sound->synth->newSynth();
+
+        if (eph.sfx.voices[i].synth == NULL)
+        {
+            pd_s->system->error("%s:%i Failed to create sfx voice %d!", __FILE__, __LINE__, i);
+        }
+    }
+}
+
+/**
+ * Picks the voice for a new sound: an idle one if there is any,
+ * otherwise the oldest of the lowest priority busy ones, as long as that isn't above the new sound's priority.
+ **/
+static SfxVoice_t *sfx_claim_voice(uint8_t priority)
+{
+    SfxVoice_t *stolen = NULL;
+
+    for (int i = 0; i < SFX_VOICE_COUNT; i++)
+    {
+        SfxVoice_t *voice = eph.sfx.voices+i;
+
+        // the microsecond clock wraps, compare by difference
+        if ((int32_t)(voice->ends_us - eph.frame_start_us) <= 0) return voice;
+
+        if (stolen == NULL || voice->priority < stolen->priority
+            || (voice->priority == stolen->priority && (int32_t)(voice->started_us - stolen->started_us) < 0))
+        {
+            stolen = voice;
+        }
+    }
+
+    if (stolen->priority > priority) return NULL;
+
+    eph.sfx.stolen++;
+    return stolen;
+}
+
+/**
+ * Plays a sound effect from a point in a room, attenuated and panned by its distance to the player,
+ * so sounds from neighbouring rooms are heard quieter. Only reconfigures a pooled voice, never allocates.
+ **/
+static void sfx_play(SfxType_t type, Vector2Int_t room_coord, Vector2Int_t position_px, float gain, float pitch)
+{
+    if (eph.current_room_ptr == NULL || eph.player_ptr == NULL) return;
+
+    const Vector2Int_t offset =
+    {
+        ((room_coord.x - eph.current_room_ptr->coord.x) * ROOM_WIDTH * TILE_SIZE_PX)
+            + position_px.x - eph.player_ptr->entity.position_px.x,
+        ((room_coord.y - eph.current_room_ptr->coord.y) * ROOM_HEIGHT * TILE_SIZE_PX)
+            + position_px.y - eph.player_ptr->entity.position_px.y,
+    };
+
+    // most callers are off-screen NPC footsteps, reject those before any float math
+    if (abs(offset.x) >= SFX_RANGE_PX || abs(offset.y) >= SFX_RANGE_PX) return;
+
+    const int distance_sq = (offset.x * offset.x) + (offset.y * offset.y);
+    if (distance_sq >= SFX_RANGE_PX * SFX_RANGE_PX) return;
+
+    const float volume = gain * (1.0f - (sqrtf(distance_sq) * (1.0f / SFX_RANGE_PX)));
+
+    // too far or too quiet to be worth a voice
+    if (volume < SFX_MIN_VOLUME) return;
+
+    const SfxInfo_t *info = sfx_infos+type;
+    SfxVoice_t *voice = sfx_claim_voice(info->priority);
+
+    if (voice == NULL)
+    {
+        eph.sfx.dropped++;
+        return;
+    }
+
+    const float pan = fminf(fmaxf((float)offset.x / SFX_PAN_PX, -1.0f), 1.0f);
+    const float length = info->length / pitch;
+
+    pd_s->sound->synth->setWaveform(voice->synth, info->waveform);
+    pd_s->sound->synth->setAttackTime(voice->synth, info->attack);
+    pd_s->sound->synth->setDecayTime(voice->synth, info->decay);
+    pd_s->sound->synth->setSustainLevel(voice->synth, info->sustain);
+    pd_s->sound->synth->setReleaseTime(voice->synth, info->release);
+    pd_s->sound->synth->setVolume(voice->synth, volume * fminf(1.0f, 1.0f - pan), volume * fminf(1.0f, 1.0f + pan));
+    pd_s->sound->synth->playNote(voice->synth, info->frequency * pitch, 1.0f, length, 0);
+
+    voice->priority = info->priority;
+    voice->started_us = eph.frame_start_us;
+    voice->ends_us = eph.frame_start_us + (uint32_t)((length + info->release) * 1000000);
+    eph.sfx.played++;
+}
+
+// 0 at rest, 1 at full speed on either axis
+static float sfx_speed_factor(const Entity_t *entity_ptr)
+{
+    const int speed = abs(entity_ptr->mov_speed.x) > abs(entity_ptr->mov_speed.y) ? abs(entity_ptr->mov_speed.x) : abs(entity_ptr->mov_speed.y);
+    return fminf((float)speed / mov_speed_max, 1.0f);
+}
+
+static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_ptr, Room_t *room_ptr, Vector2Int_t target_speed, int accel)
+{
+    if (entity_ptr->mov_speed.x < target_speed.x)
+    {
+        entity_ptr->mov_speed.x += accel;
+        if (entity_ptr->mov_speed.x > target_speed.x) entity_ptr->mov_speed.x = target_speed.x;
+    }
+    else if (entity_ptr->mov_speed.x > target_speed.x)
+    {
+        entity_ptr->mov_speed.x -= accel;
+        if (entity_ptr->mov_speed.x < target_speed.x) entity_ptr->mov_speed.x = target_speed.x;
     }
 
     if (entity_ptr->mov_speed.y < target_speed.y)
@@ -687,10 +1555,10 @@ static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_pt
 
         Vector2Int_t eval_coll_tiles[4] =
         {
-            { (new_offset_pos.x - TILE_COLL_PX/2) / TILE_SIZE_PX, (new_offset_pos.y + TILE_COLL_PX/2) / TILE_SIZE_PX },
-            { (new_offset_pos.x + TILE_COLL_PX/2) / TILE_SIZE_PX, (new_offset_pos.y + TILE_COLL_PX) / TILE_SIZE_PX },
-            { (new_offset_pos.x - TILE_COLL_PX/2) / TILE_SIZE_PX, (new_offset_pos.y + TILE_COLL_PX) / TILE_SIZE_PX },
-            { (new_offset_pos.x + TILE_COLL_PX/2) / TILE_SIZE_PX, (new_offset_pos.y + TILE_COLL_PX/2) / TILE_SIZE_PX },
+            { px_to_tile(new_offset_pos.x - TILE_COLL_PX/2), px_to_tile(new_offset_pos.y + TILE_COLL_PX/2) },
+            { px_to_tile(new_offset_pos.x + TILE_COLL_PX/2), px_to_tile(new_offset_pos.y + TILE_COLL_PX) },
+            { px_to_tile(new_offset_pos.x - TILE_COLL_PX/2), px_to_tile(new_offset_pos.y + TILE_COLL_PX) },
+            { px_to_tile(new_offset_pos.x + TILE_COLL_PX/2), px_to_tile(new_offset_pos.y + TILE_COLL_PX/2) },
         };
         TileFlags_t eval_tile_flags[4] =
         {
@@ -703,6 +1571,9 @@ static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_pt
         //TileFlags_t sum_tile_flags = eval_tile_flags[0] | eval_tile_flags[1] | eval_tile_flags[2] | eval_tile_flags[3];
         TileFlags_t tile_flags = TILEFLAG_NONE;
         Vector2Int_t coll_tile = {0};
+        // the room left through a door can be evicted by the room change, keep what the door sound needs
+        const uint16_t start_room_idx = global_ptr != NULL ? global_ptr->current_room_idx : 0;
+        const Vector2Int_t start_room_coord = room_ptr->coord;
 
         for (uint8_t i = 0; i < 4; i++)
         {
@@ -713,8 +1584,13 @@ static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_pt
             // if applicable flags are added later, they should be tested above this one
             if (!(tile_flags & TILEFLAG_WALKABLE))
             {
+                TRACE(TRACE_LEVEL_DETAIL, TRACE_COLLISION, TRACE_COORD(coll_tile.x, coll_tile.y), global_ptr != NULL);
+
                 if (entity_ptr == &eph.player_ptr->entity)
                 {
+                    const float impact = sfx_speed_factor(entity_ptr);
+                    if (impact > 0.2f) sfx_play(SFX_BOUNCE, room_ptr->coord, current_pos, impact, 0.8f + (impact * 0.4f));
+
                     entity_ptr->mov_speed.x *= -0.95f;
                     entity_ptr->mov_speed.y *= -0.95f;
                 }
@@ -735,7 +1611,6 @@ static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_pt
                     if (coll_tile.x == ROOM_MIN_X)
                     {
                         room_idx--;
-                        set_current_room(room_idx-1);
                         new_pos.x = TILE_SIZE_PX * ROOM_MAX_X;
                         if (global_ptr == eph.player_ptr) eph.camera_offset.x = (default_camera_offset.x - (new_pos.x + TILE_SIZE_PX*2));
                     }
@@ -776,312 +1651,1818 @@ static void gameplay_move_entity(Entity_t *entity_ptr, GlobalEntity_t *global_pt
             }
         }
 
-        if (tile_flags & TILEFLAG_WALKABLE)
-        {
-            entity_ptr->position_px = new_pos;
-        }
+        const bool changed_room = global_ptr != NULL && global_ptr->current_room_idx != start_room_idx;
+
+        if (tile_flags & TILEFLAG_WALKABLE)
+        {
+            entity_ptr->position_px = new_pos;
+
+            // a footstep every stride crossed on either axis, louder and higher the faster it's taken.
+            // strides are tiles of a position scaled up by SFX_FOOTSTEPS_PER_TILE, so the tile helper's reciprocal applies
+            if (!changed_room
+                && (px_to_tile_floor(current_pos.x * SFX_FOOTSTEPS_PER_TILE) != px_to_tile_floor(new_pos.x * SFX_FOOTSTEPS_PER_TILE)
+                 || px_to_tile_floor(current_pos.y * SFX_FOOTSTEPS_PER_TILE) != px_to_tile_floor(new_pos.y * SFX_FOOTSTEPS_PER_TILE)))
+            {
+                const float speed = sfx_speed_factor(entity_ptr);
+                sfx_play(SFX_FOOTSTEP, room_ptr->coord, new_pos, 0.2f + (speed * 0.5f), 0.8f + (speed * 0.4f));
+            }
+        }
+
+        // played from the door in the room being left, once the player's position matches its new room
+        if (changed_room) sfx_play(SFX_DOOR, start_room_coord, current_pos, 1.0f, 1.0f);
+    }
+}
+
+static void rewind_capture_room(Room_t *room_ptr);
+
+static void update_local_entities(Room_t *room_ptr)
+{
+    Entity_t *entity = NULL;
+    Direction_t dir = DIR_NONE;
+    Vector2Int_t target_vector = {0};
+    uint8_t viable_count = 0;
+    uint8_t dir_idx = 0;
+    Direction_t viable_dirs[4] = {0};
+
+    rewind_capture_room(room_ptr);
+    room_ptr->dirty = true;
+
+    for (uint16_t i = 0; i < room_ptr->local_entity_count; i++)
+    {
+        entity = room_ptr->entities+i;
+
+        if (entity->mov_speed.x == 0 && entity->mov_speed.y == 0) dir = DIR_NONE;
+        else if (entity->mov_speed.x < 0) dir = DIR_LEFT;
+        else if (entity->mov_speed.x > 0) dir = DIR_RIGHT;
+        else if (entity->mov_speed.y < 0) dir = DIR_UP;
+        else if (entity->mov_speed.y > 0) dir = DIR_DOWN;
+        else dir = DIR_NONE;
+        
+        if (dir == DIR_NONE)
+        {
+            viable_count = 0;
+
+            for (Direction_t d = DIR_LEFT; d < DIR_COUNT; d++)
+            {
+                target_vector.x = px_to_tile(entity->position_px.x+direction_vectors_tile_px[d].x);
+                target_vector.y = px_to_tile(entity->position_px.y+direction_vectors_tile_px[d].y);
+
+                if (room_ptr->tiles[tile_idx(target_vector.x, target_vector.y)].flags & TILEFLAG_WALKABLE)
+                {
+                    viable_dirs[viable_count] = d;
+                    viable_count++;
+                }
+            }
+
+            if (viable_count > 0)
+            {
+                dir_idx = rng_next(&ser.ai_rng) % viable_count;
+                dir = viable_dirs[dir_idx];
+            }
+        }
+
+        // boxed in with nowhere to go, stand still
+        entity->heading = dir;
+        target_vector.x = dir == DIR_NONE ? 0 : direction_vectors[dir].x * mov_speed_min;
+        target_vector.y = dir == DIR_NONE ? 0 : direction_vectors[dir].y * mov_speed_min;
+
+        gameplay_move_entity(entity, NULL, room_ptr, target_vector, mov_accel_min);
+    }
+}
+
+/**
+ * Entity render queue.
+ * Sprites and vision cones of every visible room are culled against the screen once as they're queued,
+ * then sorted by layer and y and submitted after all tiles, so all sprites go out as one run
+ * followed by all cone lines, with nothing drawn under a neighbouring room's tiles.
+ **/
+static void render_queue_init(void)
+{
+    eph.render.items = arena_alloc_region(ARENA_PERSISTENT, sizeof(RenderItem_t) * RENDER_QUEUE_MAX);
+    eph.render.sorted = arena_alloc_region(ARENA_PERSISTENT, sizeof(RenderItem_t *) * RENDER_QUEUE_MAX);
+
+    if (eph.render.items == NULL || eph.render.sorted == NULL)
+    {
+        pd_s->system->error("%s:%i Persistent memory budget of %d bytes is too small", __FILE__, __LINE__, ARENA_PERSISTENT_BYTES);
+    }
+}
+
+static void render_queue_push(RenderLayer_t layer, int sort_y, RenderItemType_t type, int bitmap_idx, Triangle2D_t shape)
+{
+    if (eph.render.count >= RENDER_QUEUE_MAX)
+    {
+        eph.render.stats.culled++;
+        return;
+    }
+
+    RenderItem_t *item = eph.render.items+eph.render.count;
+    // y is biased so negative positions still sort below positive ones
+    item->sort_key = ((uint32_t)layer << 16) | (uint16_t)(sort_y + 0x8000);
+    item->type = type;
+    item->bitmap_idx = bitmap_idx;
+    item->shape = shape;
+
+    eph.render.sorted[eph.render.count] = item;
+    eph.render.count++;
+    eph.render.stats.queued++;
+}
+
+// an entity's sprite turned to its heading, directional variants are looked up rather than rotated per draw
+static int entity_bitmap_idx(const Entity_t *entity)
+{
+    if (entity->heading < DIR_LEFT || entity->heading >= DIR_COUNT || eph.directional_first_idx == 0) return entity->bitmap_idx;
+
+    for (uint8_t i = 0; i < DIRECTIONAL_SPRITE_COUNT; i++)
+    {
+        if ((int)directional_sprites[i] == entity->bitmap_idx) return eph.directional_first_idx + (i * DIR_COUNT) + entity->heading;
+    }
+
+    return entity->bitmap_idx;
+}
+
+static void render_queue_entity(const Entity_t *entity, Vector2Int_t offset, bool with_cone)
+{
+    static const int draw_min = -TILE_SIZE_PX;
+
+    const Vector2Int_t draw_max = { eph.screen_size.x - 1, eph.screen_size.y - 1 };
+    const Vector2Int_t draw_pos =
+    {
+        TILE_OFFSET_PX + entity->position_px.x + offset.x,
+        TILE_OFFSET_PX + entity->position_px.y + offset.y,
+    };
+
+    if (draw_pos.x < draw_min || draw_pos.x > draw_max.x
+     || draw_pos.y < draw_min || draw_pos.y > draw_max.y)
+    {
+        eph.render.stats.culled++;
+    }
+    else
+    {
+        render_queue_push(RENDER_LAYER_SPRITES, draw_pos.y, RENDER_ITEM_SPRITE, entity_bitmap_idx(entity),
+                (Triangle2D_t){ draw_pos, {0}, {0} });
+    }
+
+    if (!with_cone || entity->heading < DIR_LEFT || entity->heading >= DIR_COUNT) return;
+
+    const Vector2Int_t dir = direction_vectors[entity->heading];
+    Triangle2D_t vision_cone = {0};
+
+    vision_cone.a.x = draw_pos.x + TILE_OFFSET_PX;
+    vision_cone.a.y = draw_pos.y + TILE_OFFSET_PX;
+    vision_cone.b.x = vision_cone.a.x + ((dir.x + dir.y) * TILE_SIZE_PX * 2);
+    vision_cone.b.y = vision_cone.a.y + ((dir.y - dir.x) * TILE_SIZE_PX * 2);
+    vision_cone.c.x = vision_cone.a.x + ((dir.x - dir.y) * TILE_SIZE_PX * 2);
+    vision_cone.c.y = vision_cone.a.y + ((dir.y + dir.x) * TILE_SIZE_PX * 2);
+
+    // cones reach past their sprite, so they're culled on their own bounds
+    const Vector2Int_t corners[3] = { vision_cone.a, vision_cone.b, vision_cone.c };
+    Vector2Int_t cone_min = corners[0];
+    Vector2Int_t cone_max = corners[0];
+
+    for (uint8_t i = 1; i < 3; i++)
+    {
+        if (corners[i].x < cone_min.x) cone_min.x = corners[i].x;
+        if (corners[i].y < cone_min.y) cone_min.y = corners[i].y;
+        if (corners[i].x > cone_max.x) cone_max.x = corners[i].x;
+        if (corners[i].y > cone_max.y) cone_max.y = corners[i].y;
+    }
+
+    if (cone_max.x < 0 || cone_min.x > draw_max.x || cone_max.y < 0 || cone_min.y > draw_max.y)
+    {
+        eph.render.stats.culled++;
+        return;
+    }
+
+    render_queue_push(RENDER_LAYER_CONES, vision_cone.a.y, RENDER_ITEM_CONE, 0, vision_cone);
+}
+
+static void render_queue_visible_entities(const Vector2Int_t visible_offsets[4])
+{
+    for (uint8_t i = 0; i < eph.visible_room_count; i++)
+    {
+        const Room_t *room_ptr = eph.visible_room_ptrs[i];
+
+        for (uint8_t j = 0; j < room_ptr->local_entity_count; j++)
+        {
+            render_queue_entity(room_ptr->entities+j, visible_offsets[i], true);
+        }
+    }
+
+    // one pass over the global entities, each matched against the visible rooms
+    for (uint8_t i = 0; i < ser.global_entity_count; i++)
+    {
+        const GlobalEntity_t *global = ser.global_entities+i;
+
+        for (uint8_t j = 0; j < eph.visible_room_count; j++)
+        {
+            const Room_t *room_ptr = eph.visible_room_ptrs[j];
+            if (global->current_room_idx != room_idx_at(room_ptr->coord.x, room_ptr->coord.y)) continue;
+
+            render_queue_entity(&global->entity, visible_offsets[j], false);
+            break;
+        }
+    }
+}
+
+static void render_queue_flush(PlaydateAPI *pd)
+{
+    // insertion sort, the queue is small and arrives mostly in order
+    for (uint16_t i = 1; i < eph.render.count; i++)
+    {
+        RenderItem_t *item = eph.render.sorted[i];
+        int16_t j = i - 1;
+
+        while (j >= 0 && eph.render.sorted[j]->sort_key > item->sort_key)
+        {
+            eph.render.sorted[j+1] = eph.render.sorted[j];
+            j--;
+        }
+
+        eph.render.sorted[j+1] = item;
+    }
+
+    for (uint16_t i = 0; i < eph.render.count; i++)
+    {
+        const RenderItem_t *item = eph.render.sorted[i];
+        const Triangle2D_t *shape = &item->shape;
+
+        switch(item->type)
+        {
+        case RENDER_ITEM_SPRITE:
+            pd->graphics->drawBitmap(eph.bitmaps[item->bitmap_idx], shape->a.x, shape->a.y, kBitmapUnflipped);
+            eph.render.stats.sprites++;
+            break;
+        case RENDER_ITEM_CONE:
+            pd->graphics->drawLine(shape->a.x, shape->a.y, shape->b.x, shape->b.y, 4, kColorBlack);
+            pd->graphics->drawLine(shape->a.x, shape->a.y, shape->c.x, shape->c.y, 4, kColorBlack);
+            pd->graphics->drawLine(shape->b.x, shape->b.y, shape->c.x, shape->c.y, 4, kColorWhite);
+            eph.render.stats.lines += 3;
+            break;
+        }
+    }
+
+    eph.render.count = 0;
+}
+
+/**
+ * Draws everything visible through the camera in one pass.
+ * The visible tile rectangle is computed once in tile coordinates relative to the current room
+ * (so it may extend into neighbouring rooms, diagonals included) and only those tiles are walked.
+ * Since a room is larger than the screen, at most 2x2 rooms are ever touched.
+ * Entities go through the render queue after all tiles so neighbouring rooms can't cover them.
+ **/
+static void draw_world(PlaydateAPI *pd, Vector2Int_t offset)
+{
+    static const int draw_min = -TILE_SIZE_PX;
+
+    const Vector2Int_t draw_max = { eph.screen_size.x - 1, eph.screen_size.y - 1 };
+
+    // a tile at (relative) coordinate t is drawn at (t * TILE_SIZE_PX) + TILE_OFFSET_PX + offset,
+    // keep exactly those within [draw_min, draw_max]
+    const Vector2Int_t tile_min =
+    {
+        -px_to_tile_floor(-(draw_min - TILE_OFFSET_PX - offset.x)),
+        -px_to_tile_floor(-(draw_min - TILE_OFFSET_PX - offset.y)),
+    };
+    const Vector2Int_t tile_max =
+    {
+        px_to_tile_floor(draw_max.x - TILE_OFFSET_PX - offset.x),
+        px_to_tile_floor(draw_max.y - TILE_OFFSET_PX - offset.y),
+    };
+
+    if (tile_min.x > tile_max.x || tile_min.y > tile_max.y) return;
+
+    const Vector2Int_t room_min = { tile_to_room_x(tile_min.x), tile_to_room_y(tile_min.y) };
+    const Vector2Int_t room_max = { tile_to_room_x(tile_max.x), tile_to_room_y(tile_max.y) };
+
+    Vector2Int_t visible_offsets[4] = {0};
+    eph.visible_room_count = 0;
+    memset(&eph.render.stats, 0, sizeof(RenderStats_t));
+
+    Vector2Int_t draw_pos = {0};
+
+    for (int room_y = room_min.y; room_y <= room_max.y; room_y++)
+    {
+        for (int room_x = room_min.x; room_x <= room_max.x; room_x++)
+        {
+            Room_t *room_ptr = room_at_coord(eph.current_room_ptr->coord.x + room_x, eph.current_room_ptr->coord.y + room_y);
+            if (room_ptr == NULL || eph.visible_room_count >= 4) continue;
+
+            const Vector2Int_t room_offset =
+            {
+                offset.x + (room_x * ROOM_WIDTH * TILE_SIZE_PX),
+                offset.y + (room_y * ROOM_HEIGHT * TILE_SIZE_PX),
+            };
+
+            // clip the visible tile rectangle to this room's local tile range
+            const int x_start = tile_min.x > room_x * ROOM_WIDTH ? tile_min.x - (room_x * ROOM_WIDTH) : ROOM_MIN_X;
+            const int x_end = tile_max.x < (room_x + 1) * ROOM_WIDTH ? tile_max.x - (room_x * ROOM_WIDTH) : ROOM_MAX_X;
+            const int y_start = tile_min.y > room_y * ROOM_HEIGHT ? tile_min.y - (room_y * ROOM_HEIGHT) : ROOM_MIN_Y;
+            const int y_end = tile_max.y < (room_y + 1) * ROOM_HEIGHT ? tile_max.y - (room_y * ROOM_HEIGHT) : ROOM_MAX_Y;
+
+            for (int y = y_start; y <= y_end; y++)
+            {
+                draw_pos.y = eph.room_draw_positions.y[y] + room_offset.y;
+
+                for (int x = x_start; x <= x_end; x++)
+                {
+                    draw_pos.x = eph.room_draw_positions.x[x] + room_offset.x;
+
+                    Tile_t *tile = room_ptr->tiles+tile_idx(x, y);
+                    pd->graphics->drawBitmap(eph.bitmaps[tile->bitmap_idx],
+                            draw_pos.x, draw_pos.y, kBitmapUnflipped);
+                    eph.render.stats.tiles++;
+                }
+            }
+
+            eph.visible_room_ptrs[eph.visible_room_count] = room_ptr;
+            visible_offsets[eph.visible_room_count] = room_offset;
+            eph.visible_room_count++;
+        }
+    }
+
+    render_queue_visible_entities(visible_offsets);
+    render_queue_flush(pd);
+}
+
+static void update_adjacent_rooms(void)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (eph.adjacent_room_ptrs[i] != NULL)
+        {
+            update_local_entities(eph.adjacent_room_ptrs[i]);
+        }
+    }
+
+    // a diagonal room on screen is drawn with its entities, so it's simulated too.
+    // the list is from the last drawn frame, rooms are matched by coordinate in case the current room changed since
+    for (uint8_t i = 0; i < eph.visible_room_count; i++)
+    {
+        Room_t *room_ptr = eph.visible_room_ptrs[i];
+        const int dx = room_ptr->coord.x - eph.current_room_ptr->coord.x;
+        const int dy = room_ptr->coord.y - eph.current_room_ptr->coord.y;
+
+        if (abs(dx) == 1 && abs(dy) == 1) update_local_entities(room_ptr);
+    }
+}
+
+/**
+ * Rewind history.
+ *
+ * Every simulated tick appends a frame to a fixed-size byte ring. A frame holds undo records:
+ * the previous value of each entity (global, or local to a room updated this tick) that changed
+ * during the tick, plus the previous current room and AI rng state if they changed. Rooms that weren't simulated
+ * don't change and cost nothing, so a tick costs a bounded amount of work regardless of level size.
+ * Every REWIND_KEYFRAME_INTERVAL ticks the frame also stores an absolute snapshot of the simulated
+ * entities, which is reapplied when scrubbing lands on it to keep the undo chain from drifting.
+ * When the ring is full the oldest frames are dropped.
+ **/
+
+static void rewind_write_bytes(uint8_t **cursor, const void *src, uint32_t size)
+{
+    memcpy(*cursor, src, size);
+    *cursor += size;
+}
+
+static void rewind_read_bytes(const uint8_t **cursor, void *dst, uint32_t size)
+{
+    memcpy(dst, *cursor, size);
+    *cursor += size;
+}
+
+static void rewind_write_entity(uint8_t **cursor, const Entity_t *entity)
+{
+    const int16_t packed[4] =
+    {
+        entity->position_px.x, entity->position_px.y,
+        entity->mov_speed.x, entity->mov_speed.y,
+    };
+    const int8_t heading = entity->heading;
+
+    rewind_write_bytes(cursor, packed, sizeof(packed));
+    rewind_write_bytes(cursor, &heading, sizeof(heading));
+}
+
+static void rewind_read_entity(const uint8_t **cursor, Entity_t *entity)
+{
+    int16_t packed[4] = {0};
+    int8_t heading = 0;
+
+    rewind_read_bytes(cursor, packed, sizeof(packed));
+    rewind_read_bytes(cursor, &heading, sizeof(heading));
+
+    entity->position_px.x = packed[0];
+    entity->position_px.y = packed[1];
+    entity->mov_speed.x = packed[2];
+    entity->mov_speed.y = packed[3];
+    entity->heading = heading;
+}
+
+static void rewind_write_record(uint8_t **cursor, RewindRecordType_t type, uint16_t room_idx, uint8_t slot, const GlobalEntity_t *global, const Entity_t *entity)
+{
+    const uint8_t type_byte = type;
+
+    rewind_write_bytes(cursor, &type_byte, sizeof(type_byte));
+    rewind_write_bytes(cursor, &room_idx, sizeof(room_idx));
+
+    if (type == REWIND_REC_ROOM) return;
+
+    rewind_write_bytes(cursor, &slot, sizeof(slot));
+    if (type == REWIND_REC_GLOBAL) rewind_write_bytes(cursor, &global->current_room_idx, sizeof(global->current_room_idx));
+    rewind_write_entity(cursor, entity);
+}
+
+// centres the camera on the player right away, for when the player's room or floor changes without a door transition
+static void camera_snap_to_player(void)
+{
+    eph.camera_offset_target.x = (default_camera_offset.x - eph.player_ptr->entity.position_px.x) - TILE_SIZE_PX;
+    eph.camera_offset_target.y = (default_camera_offset.y - eph.player_ptr->entity.position_px.y) - TILE_SIZE_PX;
+    eph.camera_offset = eph.camera_offset_target;
+}
+
+static void rewind_write_rng_record(uint8_t **cursor, const Rng_t *rng)
+{
+    const uint8_t type_byte = REWIND_REC_RNG;
+    const uint16_t room_idx = REWIND_GLOBAL_ROOM_IDX;
+
+    rewind_write_bytes(cursor, &type_byte, sizeof(type_byte));
+    rewind_write_bytes(cursor, &room_idx, sizeof(room_idx));
+    rewind_write_bytes(cursor, &rng->state, sizeof(rng->state));
+}
+
+// compares the fields a record stores, struct padding isn't guaranteed to match
+static bool rewind_entity_changed(const Entity_t *prev, const Entity_t *entity)
+{
+    return prev->position_px.x != entity->position_px.x || prev->position_px.y != entity->position_px.y
+        || prev->mov_speed.x != entity->mov_speed.x || prev->mov_speed.y != entity->mov_speed.y
+        || prev->heading != entity->heading;
+}
+
+static void rewind_apply_records(const uint8_t *cursor, const uint8_t *end)
+{
+    uint8_t type = 0;
+    uint16_t room_idx = 0;
+    uint8_t slot = 0;
+    GlobalEntity_t *global = NULL;
+    Room_t *room_ptr = NULL;
+    bool room_changed = false;
+
+    while (cursor < end)
+    {
+        rewind_read_bytes(&cursor, &type, sizeof(type));
+        rewind_read_bytes(&cursor, &room_idx, sizeof(room_idx));
+
+        switch(type)
+        {
+            case REWIND_REC_ROOM:
+                if (room_idx != ser.current_room_idx)
+                {
+                    set_current_room(room_idx);
+                    room_changed = true;
+                }
+                break;
+            case REWIND_REC_RNG:
+                rewind_read_bytes(&cursor, &ser.ai_rng.state, sizeof(ser.ai_rng.state));
+                break;
+            case REWIND_REC_GLOBAL:
+                rewind_read_bytes(&cursor, &slot, sizeof(slot));
+                global = ser.global_entities+slot;
+                rewind_read_bytes(&cursor, &global->current_room_idx, sizeof(global->current_room_idx));
+                rewind_read_entity(&cursor, &global->entity);
+                break;
+            case REWIND_REC_LOCAL:
+                rewind_read_bytes(&cursor, &slot, sizeof(slot));
+                room_ptr = room_at_idx(room_idx);
+                if (room_ptr != NULL)
+                {
+                    rewind_read_entity(&cursor, room_ptr->entities+slot);
+                    room_ptr->dirty = true;
+                }
+                else cursor += REWIND_ENTITY_BYTES;
+                break;
+            default:
+                // corrupt frame, nothing sensible left to apply
+                pd_s->system->logToConsole("!! Invalid rewind record type %d !!", type);
+                cursor = end;
+                break;
+        }
+    }
+
+    // the camera offset is relative to the current room, re-base it once the player's position is restored too
+    if (room_changed && eph.player_ptr != NULL) camera_snap_to_player();
+}
+
+static void rewind_drop_oldest(void)
+{
+    RewindFrame_t *frame = eph.rewind.frames+eph.rewind.frame_first;
+
+    eph.rewind.bytes_used -= frame->undo_size + frame->key_size;
+    eph.rewind.frame_first = (eph.rewind.frame_first + 1) % REWIND_FRAME_MAX;
+    eph.rewind.frame_count--;
+}
+
+static void rewind_push_frame(uint16_t undo_size, uint16_t key_size)
+{
+    const uint32_t size = undo_size + key_size;
+
+    while (eph.rewind.frame_count > 0
+       && (eph.rewind.frame_count >= REWIND_FRAME_MAX || eph.rewind.bytes_used + size > REWIND_BUFFER_BYTES))
+    {
+        rewind_drop_oldest();
+    }
+
+    RewindFrame_t *frame = eph.rewind.frames+((eph.rewind.frame_first + eph.rewind.frame_count) % REWIND_FRAME_MAX);
+    frame->offset = eph.rewind.bytes_head;
+    frame->undo_size = undo_size;
+    frame->key_size = key_size;
+
+    // copy into the ring, wrapping once at most since a frame is smaller than the ring
+    const uint32_t first_part = size < REWIND_BUFFER_BYTES - eph.rewind.bytes_head ? size : REWIND_BUFFER_BYTES - eph.rewind.bytes_head;
+    memcpy(eph.rewind.buffer + eph.rewind.bytes_head, eph.rewind.scratch, first_part);
+    memcpy(eph.rewind.buffer, eph.rewind.scratch + first_part, size - first_part);
+
+    eph.rewind.bytes_head = (eph.rewind.bytes_head + size) % REWIND_BUFFER_BYTES;
+    eph.rewind.bytes_used += size;
+    eph.rewind.frame_count++;
+}
+
+static RewindFrame_t *rewind_newest_frame(void)
+{
+    if (eph.rewind.frame_count == 0) return NULL;
+    return eph.rewind.frames+((eph.rewind.frame_first + eph.rewind.frame_count - 1) % REWIND_FRAME_MAX);
+}
+
+static void rewind_load_frame(const RewindFrame_t *frame)
+{
+    const uint32_t size = frame->undo_size + frame->key_size;
+    const uint32_t first_part = size < REWIND_BUFFER_BYTES - frame->offset ? size : REWIND_BUFFER_BYTES - frame->offset;
+
+    memcpy(eph.rewind.scratch, eph.rewind.buffer + frame->offset, first_part);
+    memcpy(eph.rewind.scratch + first_part, eph.rewind.buffer, size - first_part);
+}
+
+static void rewind_begin_tick(void)
+{
+    eph.rewind.captured_room_count = 0;
+    eph.rewind.captured_current_room_idx = ser.current_room_idx;
+    eph.rewind.captured_ai_rng = ser.ai_rng;
+    memcpy(eph.rewind.captured_globals, ser.global_entities, sizeof(GlobalEntity_t) * ser.global_entity_count);
+}
+
+// called right before a room is simulated, so its pre-tick state can be diffed at the end of the tick
+static void rewind_capture_room(Room_t *room_ptr)
+{
+    if (eph.rewind.captured_room_count >= REWIND_ROOMS_MAX) return;
+
+    RewindCapture_t *capture = eph.rewind.captured_rooms+eph.rewind.captured_room_count;
+    capture->room_idx = room_idx_at(room_ptr->coord.x, room_ptr->coord.y);
+    capture->entity_count = room_ptr->local_entity_count;
+    memcpy(capture->entities, room_ptr->entities, sizeof(Entity_t) * room_ptr->local_entity_count);
+    eph.rewind.captured_room_count++;
+}
+
+static void rewind_end_tick(void)
+{
+    uint8_t *cursor = eph.rewind.scratch;
+    const bool keyframe = (eph.rewind.tick % REWIND_KEYFRAME_INTERVAL) == 0;
+
+    // undo records: previous values of whatever changed this tick
+    if (eph.rewind.captured_current_room_idx != ser.current_room_idx)
+    {
+        rewind_write_record(&cursor, REWIND_REC_ROOM, eph.rewind.captured_current_room_idx, 0, NULL, NULL);
+    }
+
+    if (eph.rewind.captured_ai_rng.state != ser.ai_rng.state)
+    {
+        rewind_write_rng_record(&cursor, &eph.rewind.captured_ai_rng);
+    }
+
+    for (uint8_t i = 0; i < ser.global_entity_count; i++)
+    {
+        const GlobalEntity_t *prev = eph.rewind.captured_globals+i;
+        const GlobalEntity_t *global = ser.global_entities+i;
+        if (prev->current_room_idx == global->current_room_idx && !rewind_entity_changed(&prev->entity, &global->entity)) continue;
+        rewind_write_record(&cursor, REWIND_REC_GLOBAL, REWIND_GLOBAL_ROOM_IDX, i, prev, &prev->entity);
+    }
+
+    for (uint8_t i = 0; i < eph.rewind.captured_room_count; i++)
+    {
+        const RewindCapture_t *capture = eph.rewind.captured_rooms+i;
+        const Room_t *room_ptr = room_at_idx(capture->room_idx);
+
+        for (uint8_t j = 0; j < capture->entity_count; j++)
+        {
+            if (!rewind_entity_changed(capture->entities+j, room_ptr->entities+j)) continue;
+            rewind_write_record(&cursor, REWIND_REC_LOCAL, capture->room_idx, j, NULL, capture->entities+j);
+        }
+    }
+
+    const uint16_t undo_size = cursor - eph.rewind.scratch;
+
+    // keyframe: absolute state of everything simulated this tick
+    if (keyframe)
+    {
+        rewind_write_record(&cursor, REWIND_REC_ROOM, ser.current_room_idx, 0, NULL, NULL);
+        rewind_write_rng_record(&cursor, &ser.ai_rng);
+
+        for (uint8_t i = 0; i < ser.global_entity_count; i++)
+        {
+            rewind_write_record(&cursor, REWIND_REC_GLOBAL, REWIND_GLOBAL_ROOM_IDX, i, ser.global_entities+i, &ser.global_entities[i].entity);
+        }
+
+        for (uint8_t i = 0; i < eph.rewind.captured_room_count; i++)
+        {
+            const RewindCapture_t *capture = eph.rewind.captured_rooms+i;
+            const Room_t *room_ptr = room_at_idx(capture->room_idx);
+
+            for (uint8_t j = 0; j < room_ptr->local_entity_count; j++)
+            {
+                rewind_write_record(&cursor, REWIND_REC_LOCAL, capture->room_idx, j, NULL, room_ptr->entities+j);
+            }
+        }
+    }
+
+    rewind_push_frame(undo_size, (cursor - eph.rewind.scratch) - undo_size);
+    eph.rewind.tick++;
+}
+
+// steps the simulation back by up to tick_count ticks, returns the number of ticks actually rewound
+static uint16_t rewind_scrub(uint16_t tick_count)
+{
+    uint16_t rewound = 0;
+
+    while (rewound < tick_count && eph.rewind.frame_count > 1)
+    {
+        const RewindFrame_t *frame = rewind_newest_frame();
+
+        rewind_load_frame(frame);
+        rewind_apply_records(eph.rewind.scratch, eph.rewind.scratch + frame->undo_size);
+
+        eph.rewind.bytes_head = frame->offset;
+        eph.rewind.bytes_used -= frame->undo_size + frame->key_size;
+        eph.rewind.frame_count--;
+        eph.rewind.tick--;
+        rewound++;
+
+        // landed on a keyframe, resync to its absolute snapshot
+        frame = rewind_newest_frame();
+
+        if (frame->key_size > 0)
+        {
+            rewind_load_frame(frame);
+            rewind_apply_records(eph.rewind.scratch + frame->undo_size, eph.rewind.scratch + frame->undo_size + frame->key_size);
+        }
+    }
+
+    return rewound;
+}
+
+static void rewind_reset(void)
+{
+    eph.rewind.tick = 0;
+    eph.rewind.bytes_head = 0;
+    eph.rewind.bytes_used = 0;
+    eph.rewind.frame_first = 0;
+    eph.rewind.frame_count = 0;
+    eph.rewind.crank_accum = 0.0f;
+}
+
+#if TRACE_LEVEL > 0
+// microseconds since boot: the start of this frame plus time spent in it so far
+static uint32_t trace_clock(void)
+{
+    return eph.frame_start_us + (uint32_t)(pd_s->system->getElapsedTime() * 1000000);
+}
+
+// writes the trace buffer out oldest event first, for tools/tracedecode.c
+static void trace_dump(void)
+{
+    const TraceBuffer_t *trace = trace_buffer();
+    const uint32_t first_part = trace->count < TRACE_CAPACITY - trace->first ? trace->count : TRACE_CAPACITY - trace->first;
+
+    TraceHeader_t header = { .version = TRACE_VERSION, .event_size = sizeof(TraceEvent_t), .count = trace->count, .overwritten = trace->overwritten };
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+
+    SDFile *file = pd_s->file->open(TRACE_FILENAME, kFileWrite);
+
+    if (file == NULL)
+    {
+        pd_s->system->logToConsole("!! Couldn't open %s for writing: %s !!", TRACE_FILENAME, pd_s->file->geterr());
+        return;
+    }
+
+    pd_s->file->write(file, &header, sizeof(header));
+    pd_s->file->write(file, trace->events+trace->first, first_part * sizeof(TraceEvent_t));
+    pd_s->file->write(file, trace->events, (trace->count - first_part) * sizeof(TraceEvent_t));
+    pd_s->file->close(file);
+
+    pd_s->system->logToConsole("Wrote %d trace events to %s (%d overwritten).", trace->count, TRACE_FILENAME, trace->overwritten);
+}
+#endif
+
+static bool load_atlas(const char *path)
+{
+    FileStat stat = {0};
+    SDFile *file = NULL;
+    uint8_t *buffer = NULL;
+    bool success = false;
+
+    if (pd_s->file->stat(path, &stat) != 0 || stat.size < sizeof(AtlasHeader_t)) return false;
+
+    // borrowed level memory, the atlas file is only needed while its bitmaps are copied out.
+    // the atlas loads before the first floor is set up, so the whole level budget is free for it
+    Arena_t *scratch = eph.arenas+ARENA_LEVEL;
+    const uint32_t scratch_mark = arena_mark(scratch);
+
+    if (stat.size > scratch->capacity - scratch->used)
+    {
+        pd_s->system->logToConsole("!! Sprite atlas %s is %u bytes, only %u bytes of level memory are free to load it (ARENA_LEVEL_BYTES) !!",
+                path, (unsigned)stat.size, (unsigned)(scratch->capacity - scratch->used));
+        return false;
+    }
+
+    buffer = arena_alloc_region(ARENA_LEVEL, stat.size);
+    if (buffer == NULL) return false;
+
+    file = pd_s->file->open(path, kFileRead);
+
+    if (file != NULL)
+    {
+        // the whole atlas is read in one go, every bitmap is then copied out of this buffer
+        success = pd_s->file->read(file, buffer, stat.size) == (int)stat.size;
+        pd_s->file->close(file);
+    }
+
+    const AtlasHeader_t *header = (const AtlasHeader_t *)buffer;
+    const AtlasEntry_t *entries = (const AtlasEntry_t *)(buffer + sizeof(AtlasHeader_t));
+
+    if (success)
+    {
+        success = memcmp(header->magic, ATLAS_MAGIC, sizeof(header->magic)) == 0
+            && header->version == ATLAS_VERSION
+            && header->count >= BITMAP_COUNT && header->count <= BITMAP_MAX
+            && sizeof(AtlasHeader_t) + (header->count * sizeof(AtlasEntry_t)) <= stat.size;
+    }
+
+    for (uint16_t i = 0; success && i < header->count; i++)
+    {
+        const AtlasEntry_t *entry = entries+i;
+        const uint32_t plane_size = (uint32_t)entry->rowbytes * entry->height;
+        const bool has_mask = entry->flags & ATLASFLAG_MASK;
+
+        // written so a bad offset or size can't wrap around past the check
+        if (entry->rowbytes < (entry->width + 7) / 8
+         || entry->data_offset > stat.size || plane_size > stat.size - entry->data_offset
+         || (has_mask && (entry->mask_offset > stat.size || plane_size > stat.size - entry->mask_offset)))
+        {
+            pd_s->system->logToConsole("!! Sprite atlas entry %d is out of bounds !!", i);
+            success = false;
+            break;
+        }
+
+        LCDBitmap *bitmap = pd_s->graphics->newBitmap(entry->width, entry->height, has_mask ? kColorClear : kColorBlack);
+        if (bitmap == NULL)
+        {
+            success = false;
+            break;
+        }
+
+        int width = 0;
+        int height = 0;
+        int rowbytes = 0;
+        uint8_t *mask = NULL;
+        uint8_t *data = NULL;
+
+        pd_s->graphics->getBitmapData(bitmap, &width, &height, &rowbytes, &mask, &data);
+
+        // a stale or malformed atlas could have rows wider than the bitmap it's copied into
+        if (entry->rowbytes > rowbytes || entry->height > height)
+        {
+            pd_s->system->logToConsole("!! Sprite atlas entry %d rows don't fit its bitmap !!", i);
+            pd_s->graphics->freeBitmap(bitmap);
+            success = false;
+            break;
+        }
+
+        for (uint16_t y = 0; y < entry->height; y++)
+        {
+            memcpy(data + (y * rowbytes), buffer + entry->data_offset + (y * entry->rowbytes), entry->rowbytes);
+            if (has_mask && mask != NULL) memcpy(mask + (y * rowbytes), buffer + entry->mask_offset + (y * entry->rowbytes), entry->rowbytes);
+        }
+
+        eph.bitmaps[i] = bitmap;
+        eph.bitmap_count = i+1;
+    }
+
+    // don't leave a partial atlas behind
+    if (!success)
+    {
+        for (uint16_t i = 0; i < eph.bitmap_count; i++)
+        {
+            pd_s->graphics->freeBitmap(eph.bitmaps[i]);
+            eph.bitmaps[i] = NULL;
+        }
+
+        eph.bitmap_count = 0;
+    }
+
+    arena_release(scratch, scratch_mark);
+    return success;
+}
+
+static void bitmap_put_bit(uint8_t *plane, int rowbytes, int x, int y, bool bit)
+{
+    uint8_t *byte = plane + (y * rowbytes) + (x >> 3);
+    const uint8_t mask = 0x80 >> (x & 7);
+    *byte = bit ? (*byte | mask) : (*byte & ~mask);
+}
+
+static bool bitmap_get_bit(const uint8_t *plane, int rowbytes, int x, int y)
+{
+    return (plane[(y * rowbytes) + (x >> 3)] & (0x80 >> (x & 7))) != 0;
+}
+
+// copies src into a new bitmap turned from facing left to facing dir
+static LCDBitmap *bitmap_new_directional(LCDBitmap *src, Direction_t dir)
+{
+    int width = 0;
+    int height = 0;
+    int rowbytes = 0;
+    uint8_t *mask = NULL;
+    uint8_t *data = NULL;
+
+    pd_s->graphics->getBitmapData(src, &width, &height, &rowbytes, &mask, &data);
+
+    const bool rotated = dir == DIR_UP || dir == DIR_DOWN;
+    const int dst_width = rotated ? height : width;
+    const int dst_height = rotated ? width : height;
+
+    LCDBitmap *dst = pd_s->graphics->newBitmap(dst_width, dst_height, mask != NULL ? kColorClear : kColorBlack);
+    if (dst == NULL) return NULL;
+
+    int dst_rowbytes = 0;
+    uint8_t *dst_mask = NULL;
+    uint8_t *dst_data = NULL;
+
+    pd_s->graphics->getBitmapData(dst, &width, &height, &dst_rowbytes, &dst_mask, &dst_data);
+
+    for (int y = 0; y < dst_height; y++)
+    {
+        for (int x = 0; x < dst_width; x++)
+        {
+            // source pixel for this destination pixel: mirrored for right, a quarter turn either way for up and down
+            const int src_x = dir == DIR_RIGHT ? dst_width - 1 - x : dir == DIR_UP ? y : dir == DIR_DOWN ? dst_height - 1 - y : x;
+            const int src_y = dir == DIR_UP ? dst_width - 1 - x : dir == DIR_DOWN ? x : y;
+
+            bitmap_put_bit(dst_data, dst_rowbytes, x, y, bitmap_get_bit(data, rowbytes, src_x, src_y));
+            if (mask != NULL && dst_mask != NULL) bitmap_put_bit(dst_mask, dst_rowbytes, x, y, bitmap_get_bit(mask, rowbytes, src_x, src_y));
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * Builds every directional sprite's variants once, right after the atlas is loaded,
+ * so drawing an entity facing any way is a plain unflipped draw of a cached bitmap.
+ * The left variant is the atlas bitmap itself.
+ **/
+static bool build_directional_sprites(void)
+{
+    if (eph.bitmap_count + (DIRECTIONAL_SPRITE_COUNT * DIR_COUNT) > BITMAP_MAX) return false;
+
+    const uint16_t first_idx = eph.bitmap_count;
+
+    for (uint8_t i = 0; i < DIRECTIONAL_SPRITE_COUNT; i++)
+    {
+        LCDBitmap *src = eph.bitmaps[directional_sprites[i]];
+
+        for (int dir = DIR_LEFT; dir < DIR_COUNT; dir++)
+        {
+            LCDBitmap *variant = dir == DIR_LEFT ? src : bitmap_new_directional(src, dir);
+
+            if (variant == NULL)
+            {
+                // free the variants built so far, the left facing ones are the atlas bitmaps themselves
+                for (uint16_t idx = first_idx; idx < first_idx + (i * DIR_COUNT) + dir; idx++)
+                {
+                    if ((idx - first_idx) % DIR_COUNT != DIR_LEFT) pd_s->graphics->freeBitmap(eph.bitmaps[idx]);
+                    eph.bitmaps[idx] = NULL;
+                }
+
+                return false;
+            }
+
+            eph.bitmaps[first_idx + (i * DIR_COUNT) + dir] = variant;
+        }
+    }
+
+    eph.bitmap_count += DIRECTIONAL_SPRITE_COUNT * DIR_COUNT;
+    eph.directional_first_idx = first_idx;
+    return true;
+}
+
+static int hud_format_room(char *buff, size_t buff_size, const int32_t values[2])
+{
+    return snprintf(buff, buff_size, "Room [%d,%d]", (int)values[0], (int)values[1]);
+}
+
+static int hud_format_floor(char *buff, size_t buff_size, const int32_t values[2])
+{
+    return snprintf(buff, buff_size, "Floor %d", (int)values[0]);
+}
+
+#if DEBUG_DRAW_STATS
+static int hud_format_draws(char *buff, size_t buff_size, const int32_t values[2])
+{
+    return snprintf(buff, buff_size, "Draw %d+%d", (int)values[0], (int)values[1]);
+}
+#endif
+
+// widget positions are relative to the HUD layer
+static const HudWidgetInfo_t hud_widgets[HUD_WIDGET_COUNT] =
+{
+    { { 0, 0 }, { TEXT_WIDTH, TEXT_HEIGHT }, hud_format_room },
+    { { 0, TEXT_HEIGHT }, { TEXT_WIDTH, TEXT_HEIGHT }, hud_format_floor },
+#if DEBUG_DRAW_STATS
+    { { 0, TEXT_HEIGHT*2 }, { TEXT_WIDTH, TEXT_HEIGHT }, hud_format_draws },
+#endif
+};
+
+static void hud_init(void)
+{
+    eph.hud.layer = pd_s->graphics->newBitmap(HUD_WIDTH, HUD_HEIGHT, kColorClear);
+
+    for (uint8_t i = 0; i < HUD_WIDGET_COUNT; i++)
+    {
+        eph.hud.widgets[i].bitmap = pd_s->graphics->newBitmap(hud_widgets[i].size.x, hud_widgets[i].size.y, kColorWhite);
+        eph.hud.widgets[i].dirty = true;
+    }
+
+    eph.hud.layer_dirty = true;
+}
+
+static void hud_set_values(HudWidgetIndices_t widget_idx, int32_t value_a, int32_t value_b)
+{
+    HudWidget_t *widget = eph.hud.widgets+widget_idx;
+
+    if (widget->values[0] == value_a && widget->values[1] == value_b) return;
+
+    widget->values[0] = value_a;
+    widget->values[1] = value_b;
+    widget->dirty = true;
+}
+
+/**
+ * Re-renders only the widgets whose bound values changed since the last call,
+ * then recomposites the HUD layer if any of them did.
+ * In the steady state this does no text rendering at all.
+ **/
+static void hud_update(void)
+{
+    static char text_buff[HUD_TEXT_MAX] = {0};
+
+    for (uint8_t i = 0; i < HUD_WIDGET_COUNT; i++)
+    {
+        HudWidget_t *widget = eph.hud.widgets+i;
+        if (!widget->dirty || widget->bitmap == NULL) continue;
+
+        int len = hud_widgets[i].format(text_buff, sizeof(text_buff), widget->values);
+        if (len < 0) len = 0;
+        if (len >= HUD_TEXT_MAX) len = HUD_TEXT_MAX-1;
+
+        pd_s->graphics->pushContext(widget->bitmap);
+        pd_s->graphics->clear(kColorWhite);
+        pd_s->graphics->setFont(eph.font);
+        pd_s->graphics->drawText(text_buff, len, kASCIIEncoding, 0, 0);
+        pd_s->graphics->popContext();
+
+        widget->dirty = false;
+        eph.hud.layer_dirty = true;
+    }
+
+    if (!eph.hud.layer_dirty || eph.hud.layer == NULL) return;
+
+    pd_s->graphics->pushContext(eph.hud.layer);
+    pd_s->graphics->clear(kColorClear);
+
+    for (uint8_t i = 0; i < HUD_WIDGET_COUNT; i++)
+    {
+        if (eph.hud.widgets[i].bitmap == NULL) continue;
+        pd_s->graphics->drawBitmap(eph.hud.widgets[i].bitmap, hud_widgets[i].pos.x, hud_widgets[i].pos.y, kBitmapUnflipped);
+    }
+
+    pd_s->graphics->popContext();
+    eph.hud.layer_dirty = false;
+}
+
+static void hud_draw(void)
+{
+    if (eph.hud.layer == NULL) return;
+    pd_s->graphics->drawBitmap(eph.hud.layer, HUD_POS_X, HUD_POS_Y, kBitmapUnflipped);
+}
+
+static void minimap_init(void)
+{
+    eph.minimap.bitmap = pd_s->graphics->newBitmap(MINIMAP_SIZE_PX, MINIMAP_SIZE_PX, kColorBlack);
+    eph.minimap.stale = true;
+}
+
+// the cached window in one blit, plus the player marker
+static void minimap_draw(void)
+{
+    if (eph.minimap.bitmap == NULL || eph.current_room_ptr == NULL) return;
+
+    if (eph.minimap.stale) minimap_visit(eph.current_room_ptr);
+
+    const Vector2Int_t pos = { eph.screen_size.x - MINIMAP_SIZE_PX - MINIMAP_SCREEN_MARGIN, MINIMAP_SCREEN_MARGIN };
+    pd_s->graphics->drawBitmap(eph.minimap.bitmap, pos.x, pos.y, kBitmapUnflipped);
+
+    if (eph.player_ptr == NULL) return;
+
+    const Vector2Int_t player_px = eph.player_ptr->entity.position_px;
+    const Vector2Int_t marker =
+    {
+        pos.x + ((eph.current_room_ptr->coord.x - eph.minimap.origin.x) * MINIMAP_ROOM_PX)
+            + (px_to_tile_floor(player_px.x + TILE_OFFSET_PX) >> MINIMAP_TILE_SHIFT) - (MINIMAP_MARKER_PX / 2),
+        pos.y + ((eph.current_room_ptr->coord.y - eph.minimap.origin.y) * MINIMAP_ROOM_PX)
+            + (px_to_tile_floor(player_px.y + TILE_OFFSET_PX) >> MINIMAP_TILE_SHIFT) - (MINIMAP_MARKER_PX / 2),
+    };
+
+    pd_s->graphics->fillRect(marker.x, marker.y, MINIMAP_MARKER_PX, MINIMAP_MARKER_PX, kColorXOR);
+}
+
+typedef bool (*BootStepFunction)(float deadline);
+
+typedef struct BootStageInfo
+{
+    const char *name;
+    float budget;
+    BootStepFunction step;
+} BootStageInfo_t;
+
+/**
+ * The font, atlas and audio stages are short sequences of indivisible loads.
+ * Each call runs steps from the stage cursor for as long as the deadline allows, at least one
+ * so a tiny budget can't stall the boot, and the stage is done once every step has run.
+ **/
+static bool boot_step_font(float deadline)
+{
+    eph.boot.stage_total = 3;
+
+    do
+    {
+        switch(eph.boot.stage_cursor)
+        {
+        case 0:
+        {
+            const char* err;
+
+            eph.font = pd_s->graphics->loadFont(fontpath, &err);
+
+            if ( eph.font == NULL )
+            {
+                pd_s->system->error("%s:%i Couldn't load font %s: %s", __FILE__, __LINE__, fontpath, err);
+            }
+            break;
+        }
+        case 1:
+            hud_init();
+            break;
+        case 2:
+            minimap_init();
+            break;
+        }
+
+        eph.boot.stage_cursor++;
+    }
+    while (eph.boot.stage_cursor < eph.boot.stage_total && pd_s->system->getElapsedTime() < deadline);
+
+    return eph.boot.stage_cursor >= eph.boot.stage_total;
+}
+
+static bool boot_step_atlas(float deadline)
+{
+    eph.boot.stage_total = 2;
+
+    do
+    {
+        switch(eph.boot.stage_cursor)
+        {
+        case 0:
+            if (!load_atlas(ATLAS_FILENAME))
+            {
+                pd_s->system->error("%s:%i Couldn't load sprite atlas %s", __FILE__, __LINE__, ATLAS_FILENAME);
+            }
+            break;
+        case 1:
+            if (!build_directional_sprites())
+            {
+                pd_s->system->logToConsole("!! Couldn't build directional sprites, entities won't turn !!");
+            }
+            break;
+        }
+
+        eph.boot.stage_cursor++;
+    }
+    while (eph.boot.stage_cursor < eph.boot.stage_total && pd_s->system->getElapsedTime() < deadline);
+
+    return eph.boot.stage_cursor >= eph.boot.stage_total;
+}
+
+static bool boot_step_level(float deadline)
+{
+    if (eph.boot.stage_cursor == 0)
+    {
+        eph.boot.stage_total = LEVEL_START_ROOMS;
+        populate_level_begin(&eph.boot.level_start);
+    }
+
+    // always generate at least one room per frame so a tiny budget can't stall the boot
+    do
+    {
+        bool room_success = populate_level_step(eph.boot.stage_cursor, eph.boot.level_start);
+        if (!room_success) pd_s->system->error("%s:%i Couldn't populate room #%d", __FILE__, __LINE__, eph.boot.stage_cursor);
+        eph.boot.stage_cursor++;
+    }
+    while (eph.boot.stage_cursor < eph.boot.stage_total && pd_s->system->getElapsedTime() < deadline);
+
+    if (eph.boot.stage_cursor < eph.boot.stage_total) return false;
+
+    populate_level_finish();
+    prepare_room_draw_positions();
+
+    camera_snap_to_player();
+
+    rewind_reset();
+
+    return true;
+}
+
+static bool boot_step_audio(float deadline)
+{
+    eph.boot.stage_total = 2;
+
+    do
+    {
+        switch(eph.boot.stage_cursor)
+        {
+        case 0:
+            sfx_init();
+            break;
+        case 1:
+        {
+            sequence = pd_s->sound->sequence->newSequence();
+            int ret = pd_s->sound->sequence->loadMIDIFile(sequence, "plowthrough.mid");
+
+            if (ret == 1)
+            {
+                pd_s->sound->sequence->setTime(sequence, 0);
+                pd_s->sound->sequence->play(sequence, NULL, pd_s);
+            }
+            break;
+        }
+        }
+
+        eph.boot.stage_cursor++;
+    }
+    while (eph.boot.stage_cursor < eph.boot.stage_total && pd_s->system->getElapsedTime() < deadline);
+
+    return eph.boot.stage_cursor >= eph.boot.stage_total;
+}
+
+static bool boot_step_calibrate(float deadline)
+{
+    // a single accelerometer read, there's nothing to split against the deadline
+    (void)deadline;
+
+    // calibrate accelerometer
+    pd_s->system->getAccelerometer(&eph.accelerometer_raw.x, &eph.accelerometer_raw.y, &eph.accelerometer_raw.z);
+    memcpy(&eph.accelerometer_center, &eph.accelerometer_raw, sizeof(Vector3_t));
+
+    return true;
+}
+
+// budgets are per-frame time slices in seconds, stages that can't be split just report overruns
+static const BootStageInfo_t boot_stages[BOOT_STAGE_COUNT] =
+{
+    { "Loading font", 0.010f, boot_step_font },
+    { "Loading sprites", 0.010f, boot_step_atlas },
+    { "Generating level", 0.015f, boot_step_level },
+    { "Loading music", 0.010f, boot_step_audio },
+    { "Calibrating", 0.005f, boot_step_calibrate },
+};
+
+static void game_init(void)
+{
+    pd_s->system->resetElapsedTime();
+    pd_s->system->logToConsole("Initializing game.");
+
+    pd_s->system->setPeripheralsEnabled(kAccelerometer);
+
+    bzero(&ser, sizeof(ser));
+    bzero(&eph, sizeof(eph));
+
+    arena_setup();
+    render_queue_init();
+
+#if TRACE_LEVEL > 0
+    trace_clear();
+    trace_set_clock(trace_clock);
+#endif
+
+    uint32_t seed = pd_s->system->getSecondsSinceEpoch(NULL);
+#if REPLAY_MODE != REPLAY_OFF
+    replay_open(&seed);
+#endif
+    srand(seed);
+
+    eph.phase = PHASE_PREINIT;
+    eph.boot.stage = BOOT_FONT;
+    eph.screen_size.x = pd_s->display->getWidth();
+    eph.screen_size.y = pd_s->display->getHeight();
+    eph.camera_offset_target = default_camera_offset;
+
+    pd_s->display->setRefreshRate(REFRESH_RATE_ACTIVE);
+    // Note: If you set an update callback in the kEventInit handler, the system assumes the game is pure C and doesn't run any Lua code in the game
+    // the remaining initialization is spread over the first frames by boot_update.
+    pd_s->system->setUpdateCallback(game_update, pd_s);
+}
+
+static void boot_draw(void)
+{
+    static const Vector2Int_t bar_size = { 200, 12 };
+
+    const Vector2Int_t bar_pos = { (eph.screen_size.x - bar_size.x) / 2, (eph.screen_size.y - bar_size.y) / 2 };
+
+    float progress = eph.boot.stage;
+    if (eph.boot.stage_total > 0) progress += (float)eph.boot.stage_cursor / eph.boot.stage_total;
+    progress /= BOOT_STAGE_COUNT;
+
+    pd_s->graphics->clear(kColorWhite);
+    pd_s->graphics->drawRect(bar_pos.x, bar_pos.y, bar_size.x, bar_size.y, kColorBlack);
+    pd_s->graphics->fillRect(bar_pos.x + 2, bar_pos.y + 2, (bar_size.x - 4) * progress, bar_size.y - 4, kColorBlack);
+
+    if (eph.font != NULL && eph.boot.stage < BOOT_STAGE_COUNT)
+    {
+        const char *text = boot_stages[eph.boot.stage].name;
+        pd_s->graphics->setFont(eph.font);
+        pd_s->graphics->drawText(text, strlen(text), kASCIIEncoding, bar_pos.x, bar_pos.y - TEXT_HEIGHT - 4);
     }
 }
 
-static void update_local_entities(Room_t *room_ptr)
+static void boot_report(void)
 {
-    Entity_t *entity = NULL;
-    Direction_t dir = DIR_NONE;
-    Vector2Int_t target_vector = {0};
-    uint8_t viable_count = 0;
-    uint8_t dir_idx = 0;
-    Direction_t viable_dirs[4] = {0};
+    pd_s->system->logToConsole("Boot finished: %d ms to first frame over %d frames.",
+            (int)(eph.boot.elapsed * 1000), eph.boot.frames);
 
-    for (uint16_t i = 0; i < room_ptr->local_entity_count; i++)
+    for (uint8_t i = 0; i < BOOT_STAGE_COUNT; i++)
     {
-        entity = room_ptr->entities+i;
+        pd_s->system->logToConsole("  %s: %d ms in %d frames (budget %d ms/frame).", boot_stages[i].name,
+                (int)(eph.boot.stage_times[i] * 1000), eph.boot.stage_frames[i], (int)(boot_stages[i].budget * 1000));
+    }
 
-        if (entity->mov_speed.x == 0 && entity->mov_speed.y == 0) dir = DIR_NONE;
-        else if (entity->mov_speed.x < 0) dir = DIR_LEFT;
-        else if (entity->mov_speed.x > 0) dir = DIR_RIGHT;
-        else if (entity->mov_speed.y < 0) dir = DIR_UP;
-        else if (entity->mov_speed.y > 0) dir = DIR_DOWN;
-        else dir = DIR_NONE;
-        
-        if (dir == DIR_NONE)
-        {
-            viable_count = 0;
+    arena_report();
+}
 
-            for (Direction_t d = DIR_LEFT; d < DIR_COUNT; d++)
-            {
-                target_vector.x = (entity->position_px.x+direction_vectors_tile_px[d].x)/TILE_SIZE_PX;
-                target_vector.y = (entity->position_px.y+direction_vectors_tile_px[d].y)/TILE_SIZE_PX;
+static int boot_update(void)
+{
+    BootStage_t stage = eph.boot.stage;
+    float stage_start = pd_s->system->getElapsedTime();
 
-                if (room_ptr->tiles[target_vector.x + (target_vector.y*ROOM_WIDTH)].flags & TILEFLAG_WALKABLE)
-                {
-                    viable_dirs[viable_count] = d;
-                    viable_count++;
-                }
-            }
+    eph.boot.elapsed += eph.delta_time;
+    eph.boot.frames++;
 
-            if (viable_count > 0)
-            {
-                dir_idx = rand() % viable_count;
-                dir = viable_dirs[dir_idx];
-            }
-        }
+    bool stage_done = boot_stages[stage].step(stage_start + boot_stages[stage].budget);
+    float stage_time = pd_s->system->getElapsedTime() - stage_start;
 
-        entity->heading = dir;
-        target_vector.x = direction_vectors[dir].x * mov_speed_min;
-        target_vector.y = direction_vectors[dir].y * mov_speed_min;
+    eph.boot.stage_times[stage] += stage_time;
+    eph.boot.stage_frames[stage]++;
 
-        gameplay_move_entity(entity, NULL, room_ptr, target_vector, mov_accel_min);
+    if (stage_time > boot_stages[stage].budget)
+    {
+        pd_s->system->logToConsole("Boot stage '%s' overran its budget: %d ms.", boot_stages[stage].name, (int)(stage_time * 1000));
+    }
+
+    if (stage_done)
+    {
+        eph.boot.stage++;
+        eph.boot.stage_cursor = 0;
+        eph.boot.stage_total = 0;
+    }
+
+    if (eph.boot.stage >= BOOT_STAGE_COUNT)
+    {
+        eph.boot.elapsed += pd_s->system->getElapsedTime();
+        boot_report();
+        eph.phase = PHASE_GAMEPLAY;
     }
+
+    boot_draw();
+
+    return 1;
 }
 
-static void draw_room(PlaydateAPI *pd, Room_t *room_ptr, Vector2Int_t offset)
+static void gameplay_draw(void)
 {
-    static const int draw_min = -TILE_SIZE_PX;
+    // draw gfx
+	pd_s->graphics->clear(kColorWhite);
+	pd_s->graphics->setFont(eph.font);
 
-    const Vector2Int_t draw_max = { eph.screen_size.x - 1, eph.screen_size.y - 1 };
+    if (eph.current_room_ptr != NULL)
+    {
+        draw_world(pd_s, eph.camera_offset);
+        hud_update();
+        hud_draw();
 
-    Vector2Int_t draw_pos = {0};
+        if (eph.minimap.visible) minimap_draw();
+    }
 
-    for (int x = 0; x < ROOM_WIDTH; x++)
+    eph.minimap.drawn_visible = eph.minimap.visible;
+
+    eph.drawn_camera_offset = eph.camera_offset;
+    if (eph.player_ptr != NULL) eph.drawn_player_pos = eph.player_ptr->entity.position_px;
+
+	pd_s->system->drawFPS(0,0);
+}
+
+/**
+ * A scene is static when the next frame would be pixel-identical to the last one drawn:
+ * no input, no camera or player motion, no pending HUD change and no moving entity in any visible room.
+ **/
+static bool scene_is_static(void)
+{
+    // nothing drawn yet
+    if (eph.visible_room_count == 0) return false;
+    if (eph.buttons_current != 0 || eph.buttons_pushed != 0 || eph.buttons_released != 0) return false;
+    if (eph.crank.y != 0) return false;
+    if (eph.minimap.visible != eph.minimap.drawn_visible) return false;
+    if (eph.camera_offset.x != eph.drawn_camera_offset.x || eph.camera_offset.y != eph.drawn_camera_offset.y) return false;
+
+    if (eph.player_ptr != NULL)
+    {
+        const Entity_t *player = &eph.player_ptr->entity;
+        if (player->mov_speed.x != 0 || player->mov_speed.y != 0) return false;
+        if (player->position_px.x != eph.drawn_player_pos.x || player->position_px.y != eph.drawn_player_pos.y) return false;
+    }
+
+    for (uint8_t i = 0; i < HUD_WIDGET_COUNT; i++)
     {
-        draw_pos.x = eph.room_draw_positions.x[x] + offset.x;
+        if (eph.hud.widgets[i].dirty) return false;
+    }
 
-        if (draw_pos.x < draw_min) continue;
-        if (draw_pos.x > draw_max.x) break;
+    for (uint8_t i = 0; i < eph.visible_room_count; i++)
+    {
+        const Room_t *room_ptr = eph.visible_room_ptrs[i];
 
-        for (int y = 0; y < ROOM_HEIGHT; y++)
+        for (uint8_t j = 0; j < room_ptr->local_entity_count; j++)
         {
-            draw_pos.y = eph.room_draw_positions.y[y] + offset.y;
+            if (room_ptr->entities[j].mov_speed.x != 0 || room_ptr->entities[j].mov_speed.y != 0) return false;
+        }
+    }
+
+    return true;
+}
 
-            if (draw_pos.y < draw_min) continue;
-            if (draw_pos.y > draw_max.y) break;
+/**
+ * Returns true if drawing this frame can be skipped.
+ * After a run of static frames the refresh rate is lowered, and restored on the first sign of activity.
+ **/
+static bool adaptive_refresh_skip_frame(void)
+{
+    if (!ADAPTIVE_REFRESH) return false;
 
-            Tile_t *tile = room_ptr->tiles+(x + (ROOM_WIDTH * y));
-            pd->graphics->drawBitmap(eph.bitmaps[tile->bitmap_idx],
-                    draw_pos.x, draw_pos.y, kBitmapUnflipped);
+    if (!scene_is_static())
+    {
+        if (eph.idle_throttled)
+        {
+            pd_s->display->setRefreshRate(REFRESH_RATE_ACTIVE);
+            eph.idle_throttled = false;
         }
+
+        eph.idle_frames = 0;
+        return false;
     }
 
-    Entity_t *entity = NULL;
-    Triangle2D_t vision_cone = {0};
+    if (eph.idle_frames < IDLE_FRAMES_BEFORE_THROTTLE)
+    {
+        eph.idle_frames++;
+    }
+    else if (!eph.idle_throttled)
+    {
+        pd_s->display->setRefreshRate(REFRESH_RATE_IDLE);
+        eph.idle_throttled = true;
+    }
+
+    return true;
+}
+
+/**
+ * Generates the next floor's arrival neighbourhood ahead of time, one room per frame,
+ * whenever the player is in or next to a room with stairs.
+ * The prefetched rooms are pinned in the room cache until the player takes the stairs or moves away.
+ **/
+static void floor_prefetch_update(void)
+{
+    if (eph.current_room_ptr == NULL) return;
 
-    for (uint8_t i = 0; i < room_ptr->local_entity_count; i++)
+    Room_t *stairs_room = eph.current_room_ptr->has_stairs ? eph.current_room_ptr : NULL;
+
+    for (uint8_t i = 0; stairs_room == NULL && i < 4; i++)
     {
-        entity = room_ptr->entities+i;
+        if (eph.adjacent_room_ptrs[i] != NULL && eph.adjacent_room_ptrs[i]->has_stairs) stairs_room = eph.adjacent_room_ptrs[i];
+    }
+
+    if (stairs_room == NULL)
+    {
+        eph.prefetch.active = false;
+        return;
+    }
 
-        draw_pos.x = TILE_OFFSET_PX + entity->position_px.x + offset.x;
-        if (draw_pos.x < draw_min || draw_pos.x > draw_max.x) continue;
+    const uint16_t stairs_room_idx = room_idx_at(stairs_room->coord.x, stairs_room->coord.y);
 
-        draw_pos.y = TILE_OFFSET_PX + entity->position_px.y + offset.y;
-        if (draw_pos.y < draw_min || draw_pos.y > draw_max.y) continue;
+    if (!eph.prefetch.active || eph.prefetch.room_idx != stairs_room_idx)
+    {
+        eph.prefetch.active = true;
+        eph.prefetch.room_idx = stairs_room_idx;
+        eph.prefetch.cursor = 0;
+    }
 
-        pd->graphics->drawBitmap(eph.bitmaps[entity->bitmap_idx], draw_pos.x, draw_pos.y, kBitmapUnflipped);
+    if (eph.prefetch.cursor >= LEVEL_START_ROOMS) return;
 
-        vision_cone.a.x = draw_pos.x + TILE_OFFSET_PX;
-        vision_cone.a.y = draw_pos.y + TILE_OFFSET_PX;
-        vision_cone.b.x = vision_cone.a.x + ((direction_vectors[entity->heading].x + direction_vectors[entity->heading].y) * TILE_SIZE_PX * 2);
-        vision_cone.b.y = vision_cone.a.y + ((direction_vectors[entity->heading].y - direction_vectors[entity->heading].x) * TILE_SIZE_PX * 2);
-        vision_cone.c.x = vision_cone.a.x + ((direction_vectors[entity->heading].x - direction_vectors[entity->heading].y) * TILE_SIZE_PX * 2);
-        vision_cone.c.y = vision_cone.a.y + ((direction_vectors[entity->heading].y + direction_vectors[entity->heading].x) * TILE_SIZE_PX * 2);
+    const Vector2Int_t coord =
+    {
+        stairs_room->coord.x + (eph.prefetch.cursor % 3) - 1,
+        stairs_room->coord.y + (eph.prefetch.cursor / 3) - 1,
+    };
 
-        pd->graphics->drawLine(vision_cone.a.x, vision_cone.a.y,
-                              vision_cone.b.x, vision_cone.b.y,
-                              4, kColorBlack);
-        pd->graphics->drawLine(vision_cone.a.x, vision_cone.a.y,
-                              vision_cone.c.x, vision_cone.c.y,
-                              4, kColorBlack);
-        pd->graphics->drawLine(vision_cone.b.x, vision_cone.b.y,
-                              vision_cone.c.x, vision_cone.c.y,
-                              4, kColorWhite);
+    if (coord.x >= LEVEL_MIN_X && coord.x <= LEVEL_MAX_X
+     && coord.y >= LEVEL_MIN_Y && coord.y <= LEVEL_MAX_Y)
+    {
+        room_store_get_key(ROOM_KEY(ser.level.floor+1, room_idx_at(coord.x, coord.y)));
     }
 
-    uint16_t room_idx = room_ptr->coord.x + ((room_ptr->coord.y) * LEVEL_WIDTH);
+    eph.prefetch.cursor++;
+}
+
+// stairs lead to the same room coordinates one floor down
+static void floor_descend(void)
+{
+    const uint16_t arrival_room_idx = ser.current_room_idx;
+    const uint16_t next_floor = ser.level.floor+1;
 
-    for (uint8_t i = 0; i < ser.global_entity_count; i++)
+    if (!eph.prefetch.active || eph.prefetch.room_idx != arrival_room_idx || eph.prefetch.cursor < LEVEL_START_ROOMS)
     {
-        if (ser.global_entities[i].current_room_idx == room_idx)
-        {
-            entity = &(ser.global_entities+i)->entity;
+        pd_s->system->logToConsole("Floor %d wasn't prefetched in time, generating it now.", next_floor);
+    }
 
-            draw_pos.x = TILE_OFFSET_PX + entity->position_px.x + offset.x;
-            if (draw_pos.x < draw_min || draw_pos.x > draw_max.x) continue;
+    pd_s->system->logToConsole("Descending to floor %d.", next_floor);
+    arena_report();
+    pd_s->system->logToConsole("  sfx: %u played, %u on stolen voices, %u dropped.",
+            (unsigned)eph.sfx.played, (unsigned)eph.sfx.stolen, (unsigned)eph.sfx.dropped);
 
-            draw_pos.y = TILE_OFFSET_PX + entity->position_px.y + offset.y;
-            if (draw_pos.y < draw_min || draw_pos.y > draw_max.y) continue;
+    eph.prefetch.active = false;
+    eph.current_room_ptr = NULL;
+    eph.visible_room_count = 0;
+    room_store_set_floor(next_floor, arrival_room_idx);
 
-            pd->graphics->drawBitmap(eph.bitmaps[entity->bitmap_idx], draw_pos.x, draw_pos.y, kBitmapUnflipped);
-        }
+    Room_t *room = room_store_get(arrival_room_idx);
+
+    eph.player_ptr->entity.position_px = room->spawn_px;
+    eph.player_ptr->entity.mov_speed.x = 0;
+    eph.player_ptr->entity.mov_speed.y = 0;
+    eph.player_ptr->current_room_idx = arrival_room_idx;
+    set_current_room(arrival_room_idx);
+
+    camera_snap_to_player();
+
+    // history can't cross floors, the previous one is gone
+    rewind_reset();
+}
+
+static void floor_check_stairs(void)
+{
+    if (eph.player_ptr == NULL || eph.current_room_ptr == NULL || !eph.current_room_ptr->has_stairs) return;
+
+    const Vector2Int_t center_tile =
+    {
+        px_to_tile(eph.player_ptr->entity.position_px.x + TILE_OFFSET_PX),
+        px_to_tile(eph.player_ptr->entity.position_px.y + TILE_OFFSET_PX),
+    };
+
+    if (tile_flags_at_pos(eph.current_room_ptr, center_tile.x, center_tile.y) & TILEFLAG_STAIRS)
+    {
+        floor_descend();
     }
 }
 
-static void update_adjacent_rooms(PlaydateAPI *pd, Vector2Int_t offset)
+static void update_camera(void)
 {
-    Vector2Int_t neighbour_offset = offset;
+    if (eph.player_ptr == NULL) return;
 
-    for (uint8_t i = 0; i < 4; i++)
+    float camera_follow_speed = 3.5f * eph.delta_time;
+
+    eph.camera_offset_target.x = ((default_camera_offset.x - eph.player_ptr->entity.position_px.x) - TILE_SIZE_PX) - eph.camera_peek_offset.x;
+    eph.camera_offset_target.y = ((default_camera_offset.y - eph.player_ptr->entity.position_px.y) - TILE_SIZE_PX) - eph.camera_peek_offset.y;
+
+    if (eph.camera_offset.x > eph.camera_offset_target.x)
     {
-        if (eph.adjacent_room_ptrs[i] != NULL)
-        {
-            update_local_entities(eph.adjacent_room_ptrs[i]);
-            neighbour_offset.x = offset.x+adjacent_room_offsets[i].x;
-            neighbour_offset.y = offset.y+adjacent_room_offsets[i].y;
-            draw_room(pd, eph.adjacent_room_ptrs[i], neighbour_offset);
-        }
+        eph.camera_offset.x -= (eph.camera_offset.x - eph.camera_offset_target.x) * camera_follow_speed;
+    }
+    else if (eph.camera_offset.x < eph.camera_offset_target.x)
+    {
+        eph.camera_offset.x += (eph.camera_offset_target.x - eph.camera_offset.x) * camera_follow_speed;
+    }
+
+    if (eph.camera_offset.y > eph.camera_offset_target.y)
+    {
+        eph.camera_offset.y -= (eph.camera_offset.y - eph.camera_offset_target.y) * camera_follow_speed;
+    }
+    else if (eph.camera_offset.y < eph.camera_offset_target.y)
+    {
+        eph.camera_offset.y += (eph.camera_offset_target.y - eph.camera_offset.y) * camera_follow_speed;
     }
 }
 
-static void game_init(void)
+#if LATENCY_PROBE
+/**
+ * Input latency probe.
+ * A button or crank change starts a probe, which ends on the first drawn frame whose per-frame motion
+ * of the player sprite (and separately the camera) departs from its motion before the input.
+ * Times run from the input being read to the end of that frame's update, the display refresh follows right after.
+ * Only one probe runs at a time, changes during a running probe aren't measured.
+ **/
+static void latency_probe_begin_frame(void)
 {
-    const char* err;
+    if (!eph.latency.pending) return;
 
-    pd_s->system->logToConsole("Initializing game.");
+    eph.latency.elapsed += eph.delta_time;
+    eph.latency.frames++;
+}
 
-    pd_s->system->setPeripheralsEnabled(kAccelerometer);
-    srand(pd_s->system->getSecondsSinceEpoch(NULL));
+static void latency_probe_input(void)
+{
+    const bool crank_moving = eph.crank.y != 0;
+    const bool changed = eph.buttons_pushed != 0 || eph.buttons_released != 0 || crank_moving != eph.latency.crank_moving;
 
-    bzero(&ser, sizeof(ser));
-    bzero(&eph, sizeof(eph));
+    eph.latency.crank_moving = crank_moving;
 
-    eph.phase = PHASE_PREINIT;
-    eph.screen_size.x = pd_s->display->getWidth();
-    eph.screen_size.y = pd_s->display->getHeight();
-    eph.camera_offset_target = default_camera_offset;
-    eph.font = pd_s->graphics->loadFont(fontpath, &err);
-    
-    if ( eph.font == NULL )
+    if (!changed || eph.latency.pending) return;
+
+    eph.latency.pending = true;
+    eph.latency.elapsed = -pd_s->system->getElapsedTime();
+    eph.latency.frames = 0;
+
+    for (uint8_t i = 0; i < LATENCY_TARGET_COUNT; i++)
     {
-        pd_s->system->error("%s:%i Couldn't load font %s: %s", __FILE__, __LINE__, fontpath, err);
+        eph.latency.responded[i] = false;
+        eph.latency.baseline_step[i] = eph.latency.last_step[i];
     }
+}
+
+static void latency_report(void)
+{
+    static const char *target_names[LATENCY_TARGET_COUNT] = { "player", "camera" };
+
+    char buckets_text[LATENCY_BUCKET_COUNT * 12];
 
-    for (uint16_t i = 0; i < BITMAP_COUNT; i++)
+    pd_s->system->logToConsole("Input latency over %d inputs:", eph.latency.probe_count);
+
+    for (uint8_t i = 0; i < LATENCY_TARGET_COUNT; i++)
     {
-        *((uint16_t *)eph.bitmaps_buffer[i]) = 32;
-        *((uint16_t *)(eph.bitmaps_buffer[i]+2)) = 32;
-        *((uint16_t *)(eph.bitmaps_buffer[i]+4)) = 419;
-        eph.bitmaps[i] = (LCDBitmap *)eph.bitmaps_buffer[i];
-        pd_s->graphics->loadIntoBitmap(bitmap_paths[i], eph.bitmaps[i], &err);
+        const LatencyHistogram_t *histogram = eph.latency.histograms+i;
+        const uint32_t count = histogram->count > 0 ? histogram->count : 1;
+        int text_len = 0;
 
-        if (eph.bitmaps[i] == NULL )
+        for (uint8_t b = 0; b < LATENCY_BUCKET_COUNT; b++)
         {
-            pd_s->system->error("%s:%i Couldn't load bitmap %s: %s", __FILE__, __LINE__, bitmap_paths[i], err);
+            text_len += snprintf(buckets_text + text_len, sizeof(buckets_text) - text_len, "%s%d:%d",
+                    b > 0 ? " " : "", b * LATENCY_BUCKET_MS, histogram->buckets[b]);
         }
-        else
+
+        pd_s->system->logToConsole("  %s: mean %d ms over %d.%d frames, max %d ms, %d without response.",
+                target_names[i], (int)(histogram->total_ms / count), (int)(histogram->total_frames / count),
+                (int)(((histogram->total_frames * 10) / count) % 10), (int)histogram->max_ms, (int)histogram->missed);
+        pd_s->system->logToConsole("    ms: %s", buckets_text);
+    }
+}
+
+static void latency_probe_frame_drawn(void)
+{
+    const Vector2Int_t drawn[LATENCY_TARGET_COUNT] = { eph.drawn_player_pos, eph.drawn_camera_offset };
+    const uint32_t latency_ms = (eph.latency.elapsed + pd_s->system->getElapsedTime()) * 1000;
+    bool all_responded = true;
+
+    for (uint8_t i = 0; i < LATENCY_TARGET_COUNT; i++)
+    {
+        const Vector2Int_t step = { drawn[i].x - eph.latency.last_drawn[i].x, drawn[i].y - eph.latency.last_drawn[i].y };
+
+        eph.latency.last_step[i] = step;
+        eph.latency.last_drawn[i] = drawn[i];
+
+        if (!eph.latency.pending || eph.latency.responded[i]) continue;
+
+        if (abs(step.x - eph.latency.baseline_step[i].x) > LATENCY_STEP_EPSILON_PX
+         || abs(step.y - eph.latency.baseline_step[i].y) > LATENCY_STEP_EPSILON_PX)
         {
-            //pd_s->system->logToConsole("Loaded bitmap [%s] to index [%d], address [%p].", bitmap_paths[i], i, eph.bitmaps[i]);
+            LatencyHistogram_t *histogram = eph.latency.histograms+i;
+            const uint32_t bucket = latency_ms / LATENCY_BUCKET_MS;
+
+            histogram->buckets[bucket < LATENCY_BUCKET_COUNT ? bucket : LATENCY_BUCKET_COUNT-1]++;
+            histogram->count++;
+            histogram->total_ms += latency_ms;
+            histogram->total_frames += eph.latency.frames;
+            if (latency_ms > histogram->max_ms) histogram->max_ms = latency_ms;
+
+            eph.latency.responded[i] = true;
         }
+
+        all_responded &= eph.latency.responded[i];
     }
 
-    bool level_init_success = populate_level();
+    if (!eph.latency.pending || (!all_responded && eph.latency.frames < LATENCY_TIMEOUT_FRAMES)) return;
 
-    prepare_room_draw_positions();
+    // inputs that move nothing (walking into a wall, releasing while stopped) time out
+    for (uint8_t i = 0; i < LATENCY_TARGET_COUNT; i++)
+    {
+        if (!eph.latency.responded[i]) eph.latency.histograms[i].missed++;
+    }
 
-    eph.camera_offset_target.x = (default_camera_offset.x - eph.player_ptr->entity.position_px.x) - TILE_SIZE_PX;
-    eph.camera_offset_target.y = (default_camera_offset.y - eph.player_ptr->entity.position_px.y) - TILE_SIZE_PX;
-    eph.camera_offset = eph.camera_offset_target;
+    eph.latency.pending = false;
+    eph.latency.probe_count++;
 
-    sequence = pd_s->sound->sequence->newSequence();
-    int ret = pd_s->sound->sequence->loadMIDIFile(sequence, "plowthrough.mid");
+    if ((eph.latency.probe_count % LATENCY_REPORT_INTERVAL) == 0) latency_report();
+}
+#endif
+
+// keeps facing the held direction that was already faced, otherwise turns to the first held one
+static Direction_t heading_from_buttons(PDButtons buttons, Direction_t heading)
+{
+    if (heading >= DIR_LEFT && heading < DIR_COUNT && (buttons & direction_buttons[heading])) return heading;
 
-    if (ret == 1)
+    for (int dir = DIR_LEFT; dir < DIR_COUNT; dir++)
     {
-        pd_s->sound->sequence->setTime(sequence, 0);
-        pd_s->sound->sequence->play(sequence, NULL, pd_s);
+        if (buttons & direction_buttons[dir]) return dir;
     }
 
-    // calibrate accelerometer
-    pd_s->system->getAccelerometer(&eph.accelerometer_raw.x, &eph.accelerometer_raw.y, &eph.accelerometer_raw.z);
-    memcpy(&eph.accelerometer_center, &eph.accelerometer_raw, sizeof(Vector3_t));
-
-    pd_s->display->setRefreshRate(50);
-    pd_s->system->resetElapsedTime();
-    // Note: If you set an update callback in the kEventInit handler, the system assumes the game is pure C and doesn't run any Lua code in the game
-    pd_s->system->setUpdateCallback(game_update, pd_s);
-    eph.phase = PHASE_GAMEPLAY;
+    return heading;
 }
 
-static void gameplay_draw(void)
+// tilt in g to fixed point, with the dead zone taken off so the response starts from zero at its edge
+static int tilt_dead_zone(float tilt)
 {
-    // draw gfx
-    static char text_buff[32] = {0};
+    const int tilt_fx = tilt * (1 << TILT_FX_SHIFT);
 
-	pd_s->graphics->clear(kColorWhite);
-	pd_s->graphics->setFont(eph.font);
+    if (tilt_fx > TILT_DEAD_ZONE_FX) return tilt_fx - TILT_DEAD_ZONE_FX;
+    if (tilt_fx < -TILT_DEAD_ZONE_FX) return tilt_fx + TILT_DEAD_ZONE_FX;
+    return 0;
+}
 
-    if (eph.current_room_ptr != NULL)
-    {
-        update_local_entities(eph.current_room_ptr);
-        draw_room(pd_s, eph.current_room_ptr, eph.camera_offset);
-        update_adjacent_rooms(pd_s, eph.camera_offset);
+/**
+ * Low-passes one axis of dead zoned tilt and returns its new peek offset in pixels.
+ * The offset only follows the filtered tilt once it's moved TILT_HYSTERESIS_PX away,
+ * so sensor noise and slow drift leave the camera, and with it the adaptive refresh, at rest.
+ **/
+static int tilt_filter_axis(int *filtered_fx, int target_fx, int peek_px)
+{
+    const int gap = target_fx - *filtered_fx;
+    const int step = gap / TILT_LOWPASS_DIVISOR;
 
-        snprintf(text_buff, sizeof(text_buff), "Room [%d,%d]", eph.current_room_ptr->coord.x, eph.current_room_ptr->coord.y);
-        pd_s->graphics->fillRect(0, 48, TEXT_WIDTH, TEXT_HEIGHT, kColorWhite);
-        pd_s->graphics->drawText(text_buff, strlen(text_buff), kASCIIEncoding, 0, 48);
-    }
+    // the last fraction of the gap is closed outright so the filter settles exactly
+    *filtered_fx += step != 0 ? step : gap;
 
-	pd_s->system->drawFPS(0,0);
+    const int filtered_px = (*filtered_fx * TILE_SIZE_PX) / (1 << TILT_FX_SHIFT);
+
+    // coming back to rest always lands on zero
+    if (abs(filtered_px - peek_px) >= TILT_HYSTERESIS_PX || *filtered_fx == 0) return filtered_px;
+    return peek_px;
 }
 
-static int gameplay_update(void)
+// returns false when there's no input for this tick, which only happens at the end of a replay
+static bool gameplay_read_input(void)
 {
-    // get input
+#if REPLAY_MODE == REPLAY_PLAY
+    if (!replay_read_input()) return false;
+#else
     pd_s->system->getButtonState(&eph.buttons_current, &eph.buttons_pushed, &eph.buttons_released);
     eph.crank.x = pd_s->system->getCrankAngle();
     eph.crank.y = pd_s->system->getCrankChange();
+    // docking the crank brings up the minimap in a corner of the screen, the player still walks at base speed under it
+    eph.minimap.visible = pd_s->system->isCrankDocked();
     pd_s->system->getAccelerometer(&eph.accelerometer_raw.x, &eph.accelerometer_raw.y, &eph.accelerometer_raw.z);
+#endif
+
+#if REPLAY_MODE == REPLAY_RECORD
+    replay_write_input();
+#endif
 
-    // if crank is moving, calibrate accelerometer
+    // if crank is moving, calibrate accelerometer, the tilt filter eases the peek back to centre
     if (eph.crank.y != 0)
     {
         memcpy(&eph.accelerometer_center, &eph.accelerometer_raw, sizeof(Vector3_t));
     }
 
-    eph.camera_peek_offset.x = (eph.accelerometer_raw.x - eph.accelerometer_center.x) * TILE_SIZE_PX;
-    eph.camera_peek_offset.y = (eph.accelerometer_raw.y - eph.accelerometer_center.y) * TILE_SIZE_PX;
+    eph.camera_peek_offset.x = tilt_filter_axis(&eph.tilt_filtered_fx.x,
+            tilt_dead_zone(eph.accelerometer_raw.x - eph.accelerometer_center.x), eph.camera_peek_offset.x);
+    eph.camera_peek_offset.y = tilt_filter_axis(&eph.tilt_filtered_fx.y,
+            tilt_dead_zone(eph.accelerometer_raw.y - eph.accelerometer_center.y), eph.camera_peek_offset.y);
 
-    // process input
-    if (eph.player_ptr != NULL)
+    return true;
+}
+
+static int gameplay_update(void)
+{
+#if LATENCY_PROBE
+    latency_probe_begin_frame();
+#endif
+
+    // get input
+    if (!gameplay_read_input())
     {
-        float crank_value = powf(eph.crank.y, 2) * eph.delta_time;
+#if REPLAY_MODE != REPLAY_OFF
+        pd_s->system->logToConsole("Replay finished after %u ticks.", (unsigned)eph.replay.tick);
+        replay_close();
+#endif
+        eph.phase = PHASE_TERMINATING;
+        return 0;
+    }
 
-        int target_speed = mov_speed_min + ((mov_speed_max - mov_speed_min) * crank_value);
-        int mov_accel_val = mov_accel_min + ((mov_accel_max - mov_accel_min) * crank_value);
+#if LATENCY_PROBE
+    latency_probe_input();
+#endif
 
-        if (target_speed > mov_speed_max) target_speed = mov_speed_max;
-        if (mov_accel_val > mov_accel_max) mov_accel_val = mov_accel_max;
+    // process input
+    if (eph.crank.y < 0)
+    {
+        // cranking backwards scrubs time back instead of simulating
+        eph.rewind.crank_accum += -eph.crank.y / REWIND_DEGREES_PER_TICK;
+        uint16_t tick_count = eph.rewind.crank_accum;
+        eph.rewind.crank_accum -= tick_count;
+        rewind_scrub(tick_count);
+    }
+    else
+    {
+        eph.rewind.crank_accum = 0.0f;
+        rewind_begin_tick();
 
-        Vector2Int_t directional_target_speed =
+        if (eph.player_ptr != NULL)
         {
-            target_speed * sign(((eph.buttons_current & kButtonRight) - (eph.buttons_current & kButtonLeft))),
-            target_speed * sign(((eph.buttons_current & kButtonDown) - (eph.buttons_current & kButtonUp))),
-        };
-        
-        gameplay_move_entity(&eph.player_ptr->entity, eph.player_ptr, eph.current_room_ptr, directional_target_speed, mov_accel_val);
+            float crank_value = powf(eph.crank.y, 2) * eph.delta_time;
 
-        float camera_follow_speed = 3.5f * eph.delta_time;
+            int target_speed = mov_speed_min + ((mov_speed_max - mov_speed_min) * crank_value);
+            int mov_accel_val = mov_accel_min + ((mov_accel_max - mov_accel_min) * crank_value);
 
-        eph.camera_offset_target.x = ((default_camera_offset.x - eph.player_ptr->entity.position_px.x) - TILE_SIZE_PX) - eph.camera_peek_offset.x;
-        eph.camera_offset_target.y = ((default_camera_offset.y - eph.player_ptr->entity.position_px.y) - TILE_SIZE_PX) - eph.camera_peek_offset.y;
+            if (target_speed > mov_speed_max) target_speed = mov_speed_max;
+            if (mov_accel_val > mov_accel_max) mov_accel_val = mov_accel_max;
 
-        if (eph.camera_offset.x > eph.camera_offset_target.x)
-        {
-            eph.camera_offset.x -= (eph.camera_offset.x - eph.camera_offset_target.x) * camera_follow_speed;
-        }
-        else if (eph.camera_offset.x < eph.camera_offset_target.x)
-        {
-            eph.camera_offset.x += (eph.camera_offset_target.x - eph.camera_offset.x) * camera_follow_speed;
-        }
+            Vector2Int_t directional_target_speed =
+            {
+                target_speed * sign(((eph.buttons_current & kButtonRight) - (eph.buttons_current & kButtonLeft))),
+                target_speed * sign(((eph.buttons_current & kButtonDown) - (eph.buttons_current & kButtonUp))),
+            };
 
-        if (eph.camera_offset.y > eph.camera_offset_target.y)
-        {
-            eph.camera_offset.y -= (eph.camera_offset.y - eph.camera_offset_target.y) * camera_follow_speed;
+            gameplay_move_entity(&eph.player_ptr->entity, eph.player_ptr, eph.current_room_ptr, directional_target_speed, mov_accel_val);
+            eph.player_ptr->entity.heading = heading_from_buttons(eph.buttons_current, eph.player_ptr->entity.heading);
         }
-        else if (eph.camera_offset.y < eph.camera_offset_target.y)
+
+        if (eph.current_room_ptr != NULL)
         {
-            eph.camera_offset.y += (eph.camera_offset_target.y - eph.camera_offset.y) * camera_follow_speed;
+            update_local_entities(eph.current_room_ptr);
+            update_adjacent_rooms();
         }
+
+        rewind_end_tick();
+
+        floor_check_stairs();
+        floor_prefetch_update();
+    }
+
+#if REPLAY_MODE != REPLAY_OFF
+    replay_hash_tick();
+#endif
+
+    update_camera();
+
+    if (eph.current_room_ptr != NULL)
+    {
+        hud_set_values(HUD_WIDGET_ROOM, eph.current_room_ptr->coord.x, eph.current_room_ptr->coord.y);
+        hud_set_values(HUD_WIDGET_FLOOR, ser.level.floor, 0);
+#if DEBUG_DRAW_STATS
+        // last drawn frame's counts: tiles, then queued sprites and cone lines
+        hud_set_values(HUD_WIDGET_DRAWS, eph.render.stats.tiles, eph.render.stats.sprites + eph.render.stats.lines);
+#endif
     }
+
+    // returning 0 tells the system nothing changed, so the display isn't updated
+    if (adaptive_refresh_skip_frame()) return 0;
+
     gameplay_draw();
 
+#if LATENCY_PROBE
+    latency_probe_frame_drawn();
+#endif
+
 	return 1;
 }
 
@@ -1092,10 +3473,16 @@ static int game_update(void* userdata)
     eph.delta_time = pd_s->system->getElapsedTime();
     pd_s->system->resetElapsedTime();
 
+    eph.frame_start_us += eph.delta_time * 1000000;
+    eph.frame_index++;
+    TRACE(TRACE_LEVEL_FRAME, TRACE_FRAME, 0, eph.frame_index);
+
+    arena_reset(eph.arenas+ARENA_FRAME);
+
     switch(eph.phase)
     {
     case PHASE_PREINIT:
-        return 1;
+        return boot_update();
     case PHASE_GAMEPLAY:
         return gameplay_update();
     case PHASE_PAUSED:
@@ -1117,12 +3504,21 @@ int eventHandler(PlaydateAPI* pd, PDSystemEvent event, uint32_t arg)
         pd_s = pd;
         game_init();
         break;
+    case kEventPause:
+    case kEventTerminate:
+#if TRACE_LEVEL > 0
+        // the system menu is the easiest way to get a trace off the device mid-game
+        trace_dump();
+#endif
+#if REPLAY_MODE != REPLAY_OFF
+        if (event == kEventTerminate) replay_close();
+        else if (eph.replay.input_file != NULL && REPLAY_MODE == REPLAY_RECORD) pd_s->file->flush(eph.replay.input_file);
+#endif
+        break;
     case kEventInitLua:
     case kEventLock:
     case kEventUnlock:
-    case kEventPause:
     case kEventResume:
-    case kEventTerminate:
     case kEventKeyPressed:
     case kEventKeyReleased:
     case kEventLowPower:
@@ -0,0 +1,63 @@
+#ifndef REPLAY_FORMAT_H
+#define REPLAY_FORMAT_H
+
+#include <stdint.h>
+
+/**
+ * Determinism checking files, written by the game in REPLAY_MODE builds
+ * and compared on the host by tools/hashdiff.c.
+ *
+ * The input log holds the seed a recorded run started from and every gameplay tick's input,
+ * the hash log holds one hash per simulation subsystem for every gameplay tick.
+ * Both are a header followed by fixed-size records (little-endian).
+ **/
+
+#define REPLAY_INPUT_MAGIC "MCIN"
+#define REPLAY_HASH_MAGIC "MCFH"
+#define REPLAY_VERSION (1)
+#define REPLAY_INPUT_FILENAME "replay_input.bin"
+#define REPLAY_HASH_RECORD_FILENAME "replay_hash_record.bin"
+#define REPLAY_HASH_PLAY_FILENAME "replay_hash_play.bin"
+
+typedef enum HashSubsystem
+{
+    HASH_LEVEL = 0,         // seeds, floor, current room, room store clock, AI rng
+    HASH_GLOBALS = 1,       // global entities, the player included
+    HASH_ROOMS = 2,         // cached rooms' entities and every room delta
+    HASH_GENERATION = 3,    // running hash over the tiles of every room generated so far
+    HASH_SUBSYSTEM_COUNT = 4,
+} HashSubsystem_t;
+
+typedef struct ReplayInputHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t frame_size;
+    uint32_t seed;
+} ReplayInputHeader_t;
+
+typedef struct ReplayInputFrame
+{
+    float delta_time;
+    float crank_angle;
+    float crank_change;
+    float accelerometer[3];
+    uint32_t buttons;
+    uint8_t crank_docked;
+    uint8_t reserved[3];
+} ReplayInputFrame_t;
+
+typedef struct ReplayHashHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t subsystem_count;
+} ReplayHashHeader_t;
+
+typedef struct ReplayHashRecord
+{
+    uint32_t tick;
+    uint32_t hashes[HASH_SUBSYSTEM_COUNT];
+} ReplayHashRecord_t;
+
+#endif
@@ -0,0 +1,734 @@
+#include <stddef.h>
+
+#include "room_gen.h"
+#include "trace.h"
+
+// maze lattice used by the spanning tree and division generators:
+// cells sit on odd grid coordinates with wall cells between them
+#define LATTICE_WIDTH ((ROOM_WIDTH-2)/2)
+#define LATTICE_HEIGHT ((ROOM_HEIGHT-2)/2)
+#define LATTICE_COUNT (LATTICE_WIDTH*LATTICE_HEIGHT)
+#define DIVISION_STACK_MAX (ROOM_WIDTH+ROOM_HEIGHT)
+
+typedef struct Chamber
+{
+    int8_t min_x;
+    int8_t min_y;
+    int8_t max_x;
+    int8_t max_y;
+} Chamber_t;
+
+const Vector2Int_t room_path_starts[4] =
+{
+    (Vector2Int_t){ROOM_MIN_X+1, ROOM_MID_Y},
+    (Vector2Int_t){ROOM_MID_X, ROOM_MIN_Y+1},
+    (Vector2Int_t){ROOM_MAX_X-1, ROOM_MID_Y},
+    (Vector2Int_t){ROOM_MID_X, ROOM_MAX_Y-1},
+};
+
+static const Vector2Int_t dir_steps[DIR_COUNT] =
+{
+    (Vector2Int_t){-1, 0},
+    (Vector2Int_t){0, -1},
+    (Vector2Int_t){1, 0},
+    (Vector2Int_t){0, 1},
+};
+
+uint32_t hash_u32(uint32_t x)
+{
+    // murmur3 finalizer
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t rng_next(Rng_t *rng)
+{
+    // xorshift32, state must never be zero
+    uint32_t x = rng->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng->state = x;
+    return x;
+}
+
+static Rng_t gen_rng(uint32_t seed)
+{
+    Rng_t rng = { hash_u32(seed) };
+    if (rng.state == 0) rng.state = 1;
+    return rng;
+}
+
+static bool cell_in_interior(int x, int y)
+{
+    return x > ROOM_MIN_X && x < ROOM_MAX_X && y > ROOM_MIN_Y && y < ROOM_MAX_Y;
+}
+
+static void fill_walls(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], CellType_t interior)
+{
+    for (uint16_t x = 0; x < ROOM_WIDTH; x++)
+    {
+        for (uint16_t y = 0; y < ROOM_HEIGHT; y++)
+        {
+            cell_grid[x][y] = cell_in_interior(x, y) ? interior : CELL_BORDER;
+        }
+    }
+}
+
+/**
+ * Carves inwards from a door's path start until it touches an open cell,
+ * so lattice based mazes reach door positions that fall between lattice cells.
+ **/
+static void connect_path_start(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], Direction_t door)
+{
+    const Vector2Int_t inwards = dir_steps[(door + 2) % DIR_COUNT];
+    Vector2Int_t curr = room_path_starts[door];
+
+    while (cell_in_interior(curr.x, curr.y))
+    {
+        cell_grid[curr.x][curr.y] = CELL_PATH_0;
+
+        for (int i = DIR_LEFT; i < DIR_COUNT; i++)
+        {
+            // don't count the cell we just carved
+            if (i == door) continue;
+
+            const int x = curr.x + dir_steps[i].x;
+            const int y = curr.y + dir_steps[i].y;
+            if (cell_in_interior(x, y) && cell_grid[x][y] >= CELL_PATH_0) return;
+        }
+
+        curr.x += inwards.x;
+        curr.y += inwards.y;
+    }
+}
+
+/**
+ * Tags every open cell with the door path that reaches it first (breadth first from all doors at once),
+ * matching the per-path cell values the random walk produces.
+ * Open cells no door reaches are closed again.
+ **/
+static bool label_paths(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], const bool door_bools[4], Arena_t *scratch)
+{
+    bool (*visited)[ROOM_HEIGHT] = arena_alloc(scratch, sizeof(bool[ROOM_WIDTH][ROOM_HEIGHT]));
+    Vector2Int_t *queue = arena_alloc(scratch, sizeof(Vector2Int_t[ROOM_WIDTH*ROOM_HEIGHT]));
+    uint16_t head = 0;
+    uint16_t tail = 0;
+
+    if (visited == NULL || queue == NULL) return false;
+
+    for (int door = DIR_LEFT; door < DIR_COUNT; door++)
+    {
+        if (!door_bools[door]) continue;
+
+        const Vector2Int_t start = room_path_starts[door];
+        if (visited[start.x][start.y] || cell_grid[start.x][start.y] < CELL_PATH_0) continue;
+
+        visited[start.x][start.y] = true;
+        cell_grid[start.x][start.y] = (CellType_t)door;
+        queue[tail++] = start;
+    }
+
+    while (head < tail)
+    {
+        const Vector2Int_t curr = queue[head++];
+
+        for (int i = DIR_LEFT; i < DIR_COUNT; i++)
+        {
+            const int x = curr.x + dir_steps[i].x;
+            const int y = curr.y + dir_steps[i].y;
+
+            if (visited[x][y] || cell_grid[x][y] < CELL_PATH_0) continue;
+
+            visited[x][y] = true;
+            cell_grid[x][y] = cell_grid[curr.x][curr.y];
+            queue[tail++] = (Vector2Int_t){x, y};
+        }
+    }
+
+    for (uint16_t x = 0; x < ROOM_WIDTH; x++)
+    {
+        for (uint16_t y = 0; y < ROOM_HEIGHT; y++)
+        {
+            if (!visited[x][y] && cell_grid[x][y] >= CELL_PATH_0) cell_grid[x][y] = CELL_CLOSED;
+        }
+    }
+
+    return true;
+}
+
+// paths that have linked up share a group, tracked as a tiny union-find over the four path indices
+static int path_group(const int path_groups[4], int path_idx)
+{
+    while (path_groups[path_idx] != path_idx) path_idx = path_groups[path_idx];
+    return path_idx;
+}
+
+static bool paths_joined(const int path_groups[4], const bool path_bools[4])
+{
+    int group = -1;
+
+    for (int path_idx = 0; path_idx < 4; path_idx++)
+    {
+        if (!path_bools[path_idx]) continue;
+        if (group < 0) group = path_group(path_groups, path_idx);
+        else if (path_group(path_groups, path_idx) != group) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Fallback for walks that dead-end inside their own group's cells before linking:
+ * carves the shortest run of interior wall cells from the first path's group to any other group
+ * until every enabled path is joined.
+ **/
+static bool link_path_groups(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], int path_groups[4], const bool path_bools[4], Arena_t *scratch)
+{
+    static const int16_t unvisited = -2;
+    static const int16_t source = -1;
+
+    // nothing to link in most rooms, only claim scratch space when needed
+    if (paths_joined(path_groups, path_bools)) return true;
+
+    Vector2Int_t *queue = arena_alloc(scratch, sizeof(Vector2Int_t[ROOM_WIDTH*ROOM_HEIGHT]));
+    int16_t (*came_from)[ROOM_HEIGHT] = arena_alloc(scratch, sizeof(int16_t[ROOM_WIDTH][ROOM_HEIGHT]));
+
+    if (queue == NULL || came_from == NULL) return false;
+
+    while (!paths_joined(path_groups, path_bools))
+    {
+        int group = -1;
+        uint16_t head = 0;
+        uint16_t tail = 0;
+        bool linked = false;
+
+        for (int path_idx = 0; path_idx < 4 && group < 0; path_idx++)
+        {
+            if (path_bools[path_idx]) group = path_group(path_groups, path_idx);
+        }
+
+        for (int x = 0; x < ROOM_WIDTH; x++)
+        {
+            for (int y = 0; y < ROOM_HEIGHT; y++)
+            {
+                came_from[x][y] = unvisited;
+
+                if (cell_grid[x][y] >= CELL_PATH_0 && path_group(path_groups, cell_grid[x][y]) == group)
+                {
+                    came_from[x][y] = source;
+                    queue[tail++] = (Vector2Int_t){x, y};
+                }
+            }
+        }
+
+        while (head < tail && !linked)
+        {
+            const Vector2Int_t curr = queue[head++];
+
+            for (int i = DIR_LEFT; i < DIR_COUNT && !linked; i++)
+            {
+                const int x = curr.x + dir_steps[i].x;
+                const int y = curr.y + dir_steps[i].y;
+
+                if (!cell_in_interior(x, y) || came_from[x][y] != unvisited) continue;
+
+                if (cell_grid[x][y] >= CELL_PATH_0)
+                {
+                    // reached another group, open up the walls we crossed to get here
+                    path_groups[path_group(path_groups, cell_grid[x][y])] = group;
+
+                    for (Vector2Int_t cell = curr; came_from[cell.x][cell.y] != source;)
+                    {
+                        const int16_t prev = came_from[cell.x][cell.y];
+                        cell_grid[cell.x][cell.y] = (CellType_t)group;
+                        cell = (Vector2Int_t){ prev % ROOM_WIDTH, prev / ROOM_WIDTH };
+                    }
+
+                    linked = true;
+                    continue;
+                }
+
+                came_from[x][y] = curr.x + (curr.y * ROOM_WIDTH);
+                queue[tail++] = (Vector2Int_t){x, y};
+            }
+        }
+
+        // the room interior is always connected, so this only guards against malformed grids
+        if (!linked) return true;
+    }
+
+    return true;
+}
+
+static bool generate_random_walk(uint32_t seed, const bool path_bools[4], CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], Arena_t *scratch)
+{
+    // limiting a single walk to a sensible amount
+    // TODO: figure out possible implications
+    static const uint16_t walk_max_len = (ROOM_WIDTH*ROOM_HEIGHT);
+
+    Rng_t rng_state = gen_rng(seed);
+    Rng_t *rng = &rng_state;
+
+    int first_path = rng_next(rng) % 4;
+
+    bool success = true;
+
+    int path_groups[4] = { 0, 1, 2, 3, };
+
+    const Vector2Int_t *path_starts = room_path_starts;
+
+    // 1. initialization
+
+    // - first close every cell
+    for (uint16_t x = 0; x < ROOM_WIDTH; x++)
+    {
+        for (uint16_t y = 0; y < ROOM_HEIGHT; y++)
+        {
+            cell_grid[x][y] = CELL_CLOSED;
+        }
+    }
+
+    // - set the bounding walls to BORDER so they don't get overriden
+    for (uint16_t x = 0; x < ROOM_WIDTH; x++)
+    {
+        cell_grid[x][ROOM_MIN_Y] = CELL_BORDER;
+        cell_grid[x][ROOM_MAX_Y] = CELL_BORDER;
+    }
+
+    for (uint16_t y = 0; y < ROOM_HEIGHT; y++)
+    {
+        cell_grid[ROOM_MIN_X][y] = CELL_BORDER;
+        cell_grid[ROOM_MAX_X][y] = CELL_BORDER;
+    }
+
+    // - add random border tiles in the room interior to discourage the tendency towards 'open space'
+    uint8_t num_rand_border = rng_next(rng) % ((ROOM_WIDTH+ROOM_HEIGHT)/8);
+    for (uint8_t i = 0; i < num_rand_border; i++)
+    {
+        cell_grid[rng_next(rng) % ((ROOM_MIN_X+2)+((ROOM_MAX_X-ROOM_MIN_X)-2))][rng_next(rng) % ((ROOM_MIN_Y+2)+((ROOM_MAX_Y-ROOM_MIN_Y)-2))] = CELL_BORDER;
+    }
+
+    for (int path_num = 0; path_num < 4; path_num++)
+    {
+        CellType_t path_idx = (first_path + path_num) % 4;
+
+        if (!path_bools[path_idx]) continue;
+
+        cell_grid[path_starts[path_idx].x][path_starts[path_idx].y] = (CellType_t)path_idx;
+    }
+
+    // walk stacks live in scratch memory rather than the (small) stack
+    const uint32_t scratch_mark = arena_mark(scratch);
+    Vector2Int_t *coord_stack = arena_alloc(scratch, sizeof(Vector2Int_t[ROOM_WIDTH*ROOM_HEIGHT]));
+    Direction_t *move_stack = arena_alloc(scratch, sizeof(Direction_t[ROOM_WIDTH*ROOM_HEIGHT]));
+
+    if (coord_stack == NULL || move_stack == NULL)
+    {
+        arena_release(scratch, scratch_mark);
+        return false;
+    }
+
+    bool reverse_path_order = (rng_next(rng) % 2) > 0;
+
+    // four random walks, until all four paths are connected to a single maze.
+    for (CellType_t path_num = 0; path_num < 4; path_num++)
+    {
+        CellType_t path_idx = (first_path + path_num) % 4;
+        if (reverse_path_order) path_idx = CELL_PATH_3 - path_idx;
+
+        if (!path_bools[path_idx]) continue;
+
+        // a path already linked up by earlier walks needs no walk of its own
+        if (paths_joined(path_groups, path_bools)) break;
+
+        int32_t walk_idx = 0;
+        // 2. start walk from pre-determined path start.
+        move_stack[0] = DIR_NONE;
+        coord_stack[0].x = path_starts[path_idx].x;
+        coord_stack[0].y = path_starts[path_idx].y;
+
+        // 3. walk and set cells 'open' until reaching either a foreign open cell (LINK), a self open cell (LOOP), or a DEAD END
+        while (walk_idx >= 0)
+        {
+            Vector2Int_t curr = coord_stack[walk_idx];
+            // - set current cell to current path index; we will change this to CLOSED if a loop is detected.
+            // - in either case, it is now marked as resolved and will not be checked again.
+            cell_grid[curr.x][curr.y] = (CellType_t)path_idx;
+
+            // - check valid directions from current cell
+            bool dirs_in_bounds[DIR_COUNT] =
+            {
+                curr.x > ROOM_MIN_X && move_stack[walk_idx] != DIR_RIGHT,
+                curr.y > ROOM_MIN_Y && move_stack[walk_idx] != DIR_DOWN,
+                curr.x < ROOM_MAX_X && move_stack[walk_idx] != DIR_LEFT,
+                curr.y < ROOM_MAX_Y && move_stack[walk_idx] != DIR_UP,
+            };
+
+            CellType_t dirs_types[DIR_COUNT] =
+            {
+                dirs_in_bounds[DIR_LEFT]  ? cell_grid[curr.x-1][curr.y] : CELL_BORDER,
+                dirs_in_bounds[DIR_UP]    ? cell_grid[curr.x][curr.y-1] : CELL_BORDER,
+                dirs_in_bounds[DIR_RIGHT] ? cell_grid[curr.x+1][curr.y] : CELL_BORDER,
+                dirs_in_bounds[DIR_DOWN]  ? cell_grid[curr.x][curr.y+1] : CELL_BORDER,
+            };
+
+            Vector2Int_t dirs_coords[DIR_COUNT] =
+            {
+                dirs_in_bounds[DIR_LEFT]  ? (Vector2Int_t){curr.x-1, curr.y} : (Vector2Int_t){0, 0},
+                dirs_in_bounds[DIR_UP]    ? (Vector2Int_t){curr.x, curr.y-1} : (Vector2Int_t){0, 0},
+                dirs_in_bounds[DIR_RIGHT] ? (Vector2Int_t){curr.x+1, curr.y} : (Vector2Int_t){0, 0},
+                dirs_in_bounds[DIR_DOWN]  ? (Vector2Int_t){curr.x, curr.y+1} : (Vector2Int_t){0, 0},
+            };
+
+            int dir_count = 0;
+            Direction_t dir_indices[DIR_COUNT] = {DIR_NONE};
+
+            for (int i = DIR_LEFT; i < DIR_COUNT; i++)
+            {
+                if (!dirs_in_bounds[i]) continue;
+
+                if (dirs_types[i] >= 0
+                 && path_group(path_groups, dirs_types[i]) == path_group(path_groups, path_idx))
+                {
+                    // ** LOOP **
+                    // skip it as if it were a border.
+                    //pd_s->system->logToConsole("Loop [%d,%d] reached in walk between [0][%d,%d] and [%d][%d,%d].",
+                    //    dirs_coords[i].x, dirs_coords[i].y, coord_stack[0].x, coord_stack[0].y, walk_idx, coord_stack[walk_idx].x, coord_stack[walk_idx].y);
+                    continue;
+                }
+
+                switch(dirs_types[i])
+                {
+                    case CELL_CLOSED:
+                        // cell is unresolved, count and list it as option for next step
+                        dir_indices[dir_count] = i;
+                        dir_count++;
+                        break;
+                    case CELL_BORDER:
+                        // cell is not counted as an option
+                        continue;
+                    case CELL_PATH_0:
+                    case CELL_PATH_1:
+                    case CELL_PATH_2:
+                    case CELL_PATH_3:
+                        // ** LINK ** 
+                        TRACE(TRACE_LEVEL_HOT, TRACE_WALK_LINK, TRACE_COORD(dirs_coords[i].x, dirs_coords[i].y), path_idx);
+                        // end walk
+                        path_groups[path_group(path_groups, dirs_types[i])] = path_group(path_groups, path_idx);
+                        walk_idx = -1;
+                        break;
+                }
+
+                if (walk_idx == -1) break;
+            }
+
+            if (walk_idx == -1) continue;
+
+            // check for dead end
+            if (dir_count == 0)
+            {
+                // ** DEAD END **
+                // backtrack one.
+                TRACE(TRACE_LEVEL_HOT, TRACE_WALK_DEAD_END, TRACE_COORD(curr.x, curr.y), path_idx);
+                walk_idx--;
+                continue;
+            }
+
+            // check if current walk exceeded allowed length;
+            // NOTE: this check must NEVER happen before the other stop conditions are tested.
+            if (walk_idx >= walk_max_len)
+            {
+                // ** WALK LIMIT REACHED **
+                // end walk.
+                //pd_s->system->logToConsole("Limit reached in walk between [0][%d,%d] and [%d][%d,%d].",
+                //    coord_stack[0].x, coord_stack[0].y, walk_idx, coord_stack[walk_idx].x, coord_stack[walk_idx].y);
+                walk_idx = -1;
+                continue;
+            }
+
+            // ** WALK CONTINUES **
+            Direction_t chosen_dir = DIR_NONE;
+
+            // if only one direction is valid, select it
+            if (dir_count == 1)
+            {
+                chosen_dir = dir_indices[0];
+            }
+            // else, select randomly from valid options
+            else
+            {
+                chosen_dir = dir_indices[rng_next(rng) % dir_count];
+            }
+
+            walk_idx++;
+            move_stack[walk_idx] = chosen_dir;
+
+            switch(chosen_dir)
+            {
+                case DIR_LEFT:
+                case DIR_UP:
+                case DIR_RIGHT:
+                case DIR_DOWN:
+                    coord_stack[walk_idx].x = dirs_coords[chosen_dir].x;
+                    coord_stack[walk_idx].y = dirs_coords[chosen_dir].y;
+                    break;
+                case DIR_NONE:
+                case DIR_COUNT:
+                  // should not happen, end walk.
+                  walk_idx = -1;
+                  success = false;
+                  break;
+            }
+        }
+    }
+
+    // 4. walks can dead-end among their own group's cells before linking, join whatever is left over.
+    success &= link_path_groups(cell_grid, path_groups, path_bools, scratch);
+
+    arena_release(scratch, scratch_mark);
+    return success;
+}
+
+static bool lattice_step_valid(int cell_x, int cell_y, Direction_t dir)
+{
+    const int x = cell_x + dir_steps[dir].x;
+    const int y = cell_y + dir_steps[dir].y;
+    return x >= 0 && x < LATTICE_WIDTH && y >= 0 && y < LATTICE_HEIGHT;
+}
+
+/**
+ * Wilson's algorithm: loop-erased random walks over the lattice until every cell joins the tree,
+ * producing a spanning tree drawn uniformly from all possible ones.
+ **/
+static bool generate_wilson(uint32_t seed, const bool door_bools[4], CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], Arena_t *scratch)
+{
+    Rng_t rng = gen_rng(seed);
+    bool in_tree[LATTICE_COUNT] = {0};
+    Direction_t walk_dirs[LATTICE_COUNT] = {0};
+
+    fill_walls(cell_grid, CELL_CLOSED);
+
+    const uint16_t root = rng_next(&rng) % LATTICE_COUNT;
+    in_tree[root] = true;
+    cell_grid[1 + ((root % LATTICE_WIDTH) * 2)][1 + ((root / LATTICE_WIDTH) * 2)] = CELL_PATH_0;
+
+    // walks start from each cell in turn, beginning at a random one
+    const uint16_t start_offset = rng_next(&rng) % LATTICE_COUNT;
+
+    for (uint16_t i = 0; i < LATTICE_COUNT; i++)
+    {
+        const uint16_t start = (start_offset + i) % LATTICE_COUNT;
+        if (in_tree[start]) continue;
+
+        // 1. walk until the tree is hit, overwriting each cell's exit direction on revisits erases loops
+        uint16_t cell = start;
+
+        while (!in_tree[cell])
+        {
+            const int cell_x = cell % LATTICE_WIDTH;
+            const int cell_y = cell / LATTICE_WIDTH;
+
+            int dir_count = 0;
+            Direction_t dir_indices[DIR_COUNT] = {DIR_NONE};
+
+            for (int dir = DIR_LEFT; dir < DIR_COUNT; dir++)
+            {
+                if (lattice_step_valid(cell_x, cell_y, dir)) dir_indices[dir_count++] = dir;
+            }
+
+            const Direction_t chosen_dir = dir_indices[rng_next(&rng) % dir_count];
+            walk_dirs[cell] = chosen_dir;
+            cell = (cell_x + dir_steps[chosen_dir].x) + ((cell_y + dir_steps[chosen_dir].y) * LATTICE_WIDTH);
+        }
+
+        // 2. retrace the loop-erased walk, carving each cell and the wall towards its successor
+        cell = start;
+
+        while (!in_tree[cell])
+        {
+            const int cell_x = cell % LATTICE_WIDTH;
+            const int cell_y = cell / LATTICE_WIDTH;
+            const Direction_t dir = walk_dirs[cell];
+            const int grid_x = 1 + (cell_x * 2);
+            const int grid_y = 1 + (cell_y * 2);
+
+            cell_grid[grid_x][grid_y] = CELL_PATH_0;
+            cell_grid[grid_x + dir_steps[dir].x][grid_y + dir_steps[dir].y] = CELL_PATH_0;
+            in_tree[cell] = true;
+            cell = (cell_x + dir_steps[dir].x) + ((cell_y + dir_steps[dir].y) * LATTICE_WIDTH);
+        }
+    }
+
+    for (int door = DIR_LEFT; door < DIR_COUNT; door++)
+    {
+        if (door_bools[door]) connect_path_start(cell_grid, door);
+    }
+
+    const uint32_t scratch_mark = arena_mark(scratch);
+    const bool success = label_paths(cell_grid, door_bools, scratch);
+    arena_release(scratch, scratch_mark);
+    return success;
+}
+
+/**
+ * Recursive division: starts from an open room and splits chambers with walls that have a single gap.
+ * Walls go on even coordinates and gaps on odd ones, so a later perpendicular wall never seals an earlier gap.
+ * Uses an explicit chamber stack rather than recursion.
+ **/
+static bool generate_division(uint32_t seed, const bool door_bools[4], CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], Arena_t *scratch)
+{
+    Rng_t rng = gen_rng(seed);
+    Chamber_t stack[DIVISION_STACK_MAX];
+    uint16_t stack_count = 0;
+
+    fill_walls(cell_grid, CELL_PATH_0);
+    stack[stack_count++] = (Chamber_t){ ROOM_MIN_X+1, ROOM_MIN_Y+1, ROOM_MAX_X-1, ROOM_MAX_Y-1 };
+
+    while (stack_count > 0)
+    {
+        const Chamber_t chamber = stack[--stack_count];
+
+        // chamber minimums are always odd, so these count the even (wall) and odd (gap) coordinates inside it
+        const int wall_slots_x = (chamber.max_x - chamber.min_x) / 2;
+        const int wall_slots_y = (chamber.max_y - chamber.min_y) / 2;
+
+        if (wall_slots_x == 0 && wall_slots_y == 0) continue;
+
+        if (stack_count + 2 > DIVISION_STACK_MAX) return false;
+
+        const int width = chamber.max_x - chamber.min_x;
+        const int height = chamber.max_y - chamber.min_y;
+        const bool vertical = wall_slots_y == 0
+            || (wall_slots_x > 0 && (width > height || (width == height && (rng_next(&rng) % 2) > 0)));
+
+        if (vertical)
+        {
+            const int wall_x = chamber.min_x + 1 + ((rng_next(&rng) % wall_slots_x) * 2);
+            const int gap_y = chamber.min_y + ((rng_next(&rng) % (wall_slots_y + 1)) * 2);
+
+            for (int y = chamber.min_y; y <= chamber.max_y; y++)
+            {
+                if (y != gap_y) cell_grid[wall_x][y] = CELL_CLOSED;
+            }
+
+            stack[stack_count++] = (Chamber_t){ chamber.min_x, chamber.min_y, wall_x - 1, chamber.max_y };
+            stack[stack_count++] = (Chamber_t){ wall_x + 1, chamber.min_y, chamber.max_x, chamber.max_y };
+        }
+        else
+        {
+            const int wall_y = chamber.min_y + 1 + ((rng_next(&rng) % wall_slots_y) * 2);
+            const int gap_x = chamber.min_x + ((rng_next(&rng) % (wall_slots_x + 1)) * 2);
+
+            for (int x = chamber.min_x; x <= chamber.max_x; x++)
+            {
+                if (x != gap_x) cell_grid[x][wall_y] = CELL_CLOSED;
+            }
+
+            stack[stack_count++] = (Chamber_t){ chamber.min_x, chamber.min_y, chamber.max_x, wall_y - 1 };
+            stack[stack_count++] = (Chamber_t){ chamber.min_x, wall_y + 1, chamber.max_x, chamber.max_y };
+        }
+    }
+
+    for (int door = DIR_LEFT; door < DIR_COUNT; door++)
+    {
+        if (door_bools[door]) connect_path_start(cell_grid, door);
+    }
+
+    const uint32_t scratch_mark = arena_mark(scratch);
+    const bool success = label_paths(cell_grid, door_bools, scratch);
+    arena_release(scratch, scratch_mark);
+    return success;
+}
+
+const RoomGenerator_t room_generators[ROOMGEN_COUNT] =
+{
+    { "random walk", generate_random_walk },
+    { "wilson", generate_wilson },
+    { "division", generate_division },
+};
+
+static bool cell_open_at(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], int x, int y)
+{
+    if (x < ROOM_MIN_X || x > ROOM_MAX_X || y < ROOM_MIN_Y || y > ROOM_MAX_Y) return false;
+    return cell_grid[x][y] >= CELL_PATH_0;
+}
+
+bool build_room_tiles(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], const bool door_bools[4], Tile_t tiles[ROOM_WIDTH*ROOM_HEIGHT])
+{
+    static const uint8_t doorh_count = 2;
+    static const uint8_t doorv_count = 2;
+
+    bool success = true;
+    Tile_t *tile = NULL;
+
+    const int32_t doorh_indices[2] =
+    {
+        door_bools[0] ? ROOM_MIN_X + (ROOM_WIDTH*ROOM_MID_Y) : -1,
+        door_bools[2] ? ROOM_MAX_X + (ROOM_WIDTH*ROOM_MID_Y) : -1,
+    };
+
+    const int32_t doorv_indices[2] =
+    {
+        door_bools[1] ? ROOM_MID_X + (ROOM_WIDTH*ROOM_MIN_Y) : -1,
+        door_bools[3] ? ROOM_MID_X + (ROOM_WIDTH*ROOM_MAX_Y) : -1,
+    };
+
+    for (int x = 0; x < ROOM_WIDTH; x++)
+    {
+        for (int y = 0; y < ROOM_HEIGHT; y++)
+        {
+            tile = tiles+(x + (ROOM_WIDTH * y));
+
+            // cells next to the room edge count the edge as open space, neighbours past it don't exist
+            uint8_t adj_space =
+            (x == (ROOM_MIN_X+1) || cell_open_at(cell_grid, x-1, y))
+             + (x == (ROOM_MAX_X-1) || cell_open_at(cell_grid, x+1, y))
+             + (y == (ROOM_MIN_Y+1) || cell_open_at(cell_grid, x, y-1))
+             + (y == (ROOM_MAX_Y-1) || cell_open_at(cell_grid, x, y+1));
+
+            switch(cell_grid[x][y])
+            {
+            case CELL_PATH_0:
+            case CELL_PATH_1:
+            case CELL_PATH_2:
+            case CELL_PATH_3:
+                tile->bitmap_idx = BITMAP_FLOOR_00 + cell_grid[x][y];
+                tile->flags = TILEFLAG_WALKABLE;
+                break;
+            case CELL_CLOSED:
+            case CELL_BORDER:
+                tile->bitmap_idx = adj_space >= 4 ? BITMAP_TABLE
+                    : adj_space >= 3 ? BITMAP_CRATE : BITMAP_WALL;
+                tile->flags = TILEFLAG_NONE;
+                break;
+            default:
+                // shouldn't happen
+                tile->bitmap_idx = BITMAP_WALL;
+                tile->flags = TILEFLAG_NONE;
+                success = false;
+                break;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < doorh_count; i++)
+    {
+        if (doorh_indices[i] < 0) continue;
+        tiles[doorh_indices[i]].bitmap_idx = BITMAP_DOOR_H;
+        tiles[doorh_indices[i]].flags = (TILEFLAG_DOOR_H | TILEFLAG_WALKABLE);
+    }
+
+    for (uint8_t i = 0; i < doorv_count; i++)
+    {
+        if (doorv_indices[i] < 0) continue;
+        tiles[doorv_indices[i]].bitmap_idx = BITMAP_DOOR_V;
+        tiles[doorv_indices[i]].flags = (TILEFLAG_DOOR_V | TILEFLAG_WALKABLE);
+    }
+
+    return success;
+}
@@ -0,0 +1,121 @@
+#ifndef ROOM_GEN_H
+#define ROOM_GEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "geometry.h"
+
+/**
+ * Room maze generators.
+ * Kept free of any Playdate API so the same code can be compiled into host-side tools
+ * (see tools/mazebench.c).
+ *
+ * A generator fills a ROOM_WIDTH x ROOM_HEIGHT cell grid from a seed and the set of doors the room has.
+ * Open cells hold the index of the door path they belong to (CELL_PATH_0..3),
+ * walls are CELL_CLOSED or CELL_BORDER. Every enabled door's path start must end up open
+ * and connected to every other enabled door's path start.
+ *
+ * Working memory comes from the scratch arena, at most ROOM_GEN_SCRATCH_BYTES of it,
+ * and is released again before the generator returns. A generator fails if the arena runs dry.
+ **/
+
+#define ROOM_GEN_SCRATCH_BYTES (8*1024)
+
+typedef enum CellType
+{
+    CELL_BORDER = -2,
+    CELL_CLOSED = -1,
+    CELL_PATH_0 = 0,
+    CELL_PATH_1 = 1,
+    CELL_PATH_2 = 2,
+    CELL_PATH_3 = 3,
+} CellType_t;
+
+typedef enum Direction
+{
+    DIR_NONE = -1,
+    DIR_LEFT = 0,
+    DIR_UP = 1,
+    DIR_RIGHT = 2,
+    DIR_DOWN = 3,
+    DIR_COUNT = 4,
+} Direction_t;
+
+// sprite atlas order, must match assets_build.sh
+typedef enum BitmapIndices
+{
+    BITMAP_FLOOR_00 = 0,
+    BITMAP_FLOOR_01 = 1,
+    BITMAP_FLOOR_02 = 2,
+    BITMAP_FLOOR_03 = 3,
+    BITMAP_WALL = 4,
+    BITMAP_TABLE = 5,
+    BITMAP_CRATE = 6,
+    BITMAP_DOOR_H = 7,
+    BITMAP_DOOR_V = 8,
+    BITMAP_PLAYER = 9,
+    BITMAP_NPC = 10,
+    BITMAP_STAIRS = 11,
+} BitmapIndices_t;
+
+typedef enum TileFlags
+{
+    TILEFLAG_NONE = 0x00,
+    TILEFLAG_WALKABLE = 0x01,
+    TILEFLAG_DOOR_H = 0x02,
+    TILEFLAG_DOOR_V = 0x04,
+    TILEFLAG_STAIRS = 0x08,
+} TileFlags_t;
+
+typedef enum RoomGeneratorIndices
+{
+    ROOMGEN_RANDOM_WALK = 0,
+    ROOMGEN_WILSON = 1,
+    ROOMGEN_DIVISION = 2,
+    ROOMGEN_COUNT = 3,
+} RoomGeneratorIndices_t;
+
+typedef struct Vector2Int
+{
+    int x;
+    int y;
+} Vector2Int_t;
+
+typedef struct Tile
+{
+    TileFlags_t flags;
+    int bitmap_idx;
+} Tile_t;
+
+typedef struct Rng
+{
+    uint32_t state;
+} Rng_t;
+
+typedef bool (*RoomGenerateFunc_t)(uint32_t seed, const bool door_bools[4], CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], Arena_t *scratch);
+
+typedef struct RoomGenerator
+{
+    const char *name;
+    RoomGenerateFunc_t generate;
+} RoomGenerator_t;
+
+// indexed by RoomGeneratorIndices_t
+extern const RoomGenerator_t room_generators[ROOMGEN_COUNT];
+
+// the open cell just inside each door, indexed by Direction_t
+extern const Vector2Int_t room_path_starts[4];
+
+/**
+ * Converts a generated cell grid into room tiles, including the door tiles.
+ * Every tile is written in full, so the output doesn't depend on what the buffer held before.
+ * Returns false if the grid held an unresolved cell.
+ **/
+bool build_room_tiles(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], const bool door_bools[4], Tile_t tiles[ROOM_WIDTH*ROOM_HEIGHT]);
+
+uint32_t hash_u32(uint32_t x);
+uint32_t rng_next(Rng_t *rng);
+
+#endif
@@ -0,0 +1,55 @@
+#include <stddef.h>
+
+#include "trace.h"
+
+#if TRACE_LEVEL > 0
+
+static TraceBuffer_t trace = {0};
+static TraceClockFunc_t trace_clock = NULL;
+
+void trace_set_clock(TraceClockFunc_t clock)
+{
+    trace_clock = clock;
+}
+
+uint32_t trace_now(void)
+{
+    return trace_clock != NULL ? trace_clock() : 0;
+}
+
+void trace_emit(TraceEventType_t type, uint16_t arg0, uint32_t arg1)
+{
+    TraceEvent_t *event = NULL;
+
+    if (trace.count < TRACE_CAPACITY)
+    {
+        event = trace.events+((trace.first + trace.count) % TRACE_CAPACITY);
+        trace.count++;
+    }
+    else
+    {
+        // full, the oldest event makes room
+        event = trace.events+trace.first;
+        trace.first = (trace.first + 1) % TRACE_CAPACITY;
+        trace.overwritten++;
+    }
+
+    event->time_us = trace_now();
+    event->type = type;
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+}
+
+const TraceBuffer_t *trace_buffer(void)
+{
+    return &trace;
+}
+
+void trace_clear(void)
+{
+    trace.first = 0;
+    trace.count = 0;
+    trace.overwritten = 0;
+}
+
+#endif
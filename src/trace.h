@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/**
+ * Binary event trace.
+ * Typed, fixed-size events are written into a ring buffer without any formatting,
+ * dumped to TRACE_FILENAME by the game and turned into Chrome trace JSON on the host by tools/tracedecode.c.
+ * Kept free of any Playdate API, the game supplies the clock. Not thread safe.
+ *
+ * TRACE_LEVEL filters at compile time, events above it compile to nothing (arguments aren't evaluated):
+ *   0 - off
+ *   1 - frames, room entries and room generation
+ *   2 - also collisions
+ *   3 - also per-step generator events (random walk links and dead ends)
+ **/
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL (0)
+#endif
+
+#define TRACE_LEVEL_FRAME (1)
+#define TRACE_LEVEL_DETAIL (2)
+#define TRACE_LEVEL_HOT (3)
+
+#define TRACE_CAPACITY (4096)
+#define TRACE_MAGIC "MCTR"
+#define TRACE_VERSION (1)
+#define TRACE_FILENAME "trace.bin"
+
+// packs a cell or tile coordinate into an event's 16 bit argument
+#define TRACE_COORD(x, y) ((uint16_t)(((uint8_t)(x)) | (((uint8_t)(y)) << 8)))
+
+typedef enum TraceEventType
+{
+    TRACE_FRAME = 0,            // arg0: unused, arg1: frame index
+    TRACE_ROOM_ENTERED = 1,     // arg0: room index, arg1: floor
+    TRACE_ROOM_GENERATED = 2,   // arg0: room index, arg1: duration in microseconds, the event time is its end
+    TRACE_WALK_LINK = 3,        // arg0: cell coordinate, arg1: path index
+    TRACE_WALK_DEAD_END = 4,    // arg0: cell coordinate, arg1: path index
+    TRACE_COLLISION = 5,        // arg0: tile coordinate, arg1: 1 for global entities, 0 for room locals
+    TRACE_EVENT_TYPE_COUNT = 6,
+} TraceEventType_t;
+
+typedef struct TraceEvent
+{
+    uint32_t time_us;
+    uint16_t type;
+    uint16_t arg0;
+    uint32_t arg1;
+} TraceEvent_t;
+
+// dump file layout (little-endian): TraceHeader_t, then header.count events oldest first
+typedef struct TraceHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t event_size;
+    uint32_t count;
+    uint32_t overwritten;
+} TraceHeader_t;
+
+// events oldest first are events[first..TRACE_CAPACITY) followed by events[0..first)
+typedef struct TraceBuffer
+{
+    uint32_t first;
+    uint32_t count;
+    uint32_t overwritten;
+    TraceEvent_t events[TRACE_CAPACITY];
+} TraceBuffer_t;
+
+typedef uint32_t (*TraceClockFunc_t)(void);
+
+#if TRACE_LEVEL > 0
+
+void trace_set_clock(TraceClockFunc_t clock);
+void trace_emit(TraceEventType_t type, uint16_t arg0, uint32_t arg1);
+uint32_t trace_now(void);
+const TraceBuffer_t *trace_buffer(void);
+void trace_clear(void);
+
+#define TRACE(level, type, arg0, arg1) do { if ((level) <= TRACE_LEVEL) trace_emit((type), (arg0), (arg1)); } while (0)
+
+#else
+
+#define TRACE(level, type, arg0, arg1) ((void)0)
+
+#endif
+
+#endif
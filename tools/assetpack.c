@@ -0,0 +1,218 @@
+/**
+ * Host-side asset packer.
+ * Converts a list of PNG files into a single pre-decoded 1-bit sprite atlas
+ * (see src/atlas_format.h), in the order given on the command line.
+ *
+ * usage: assetpack <out.atlas> <in0.png> [in1.png ...]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <png.h>
+
+#include "../src/atlas_format.h"
+
+#define ATLAS_MAX_ENTRIES (1024)
+#define LUMA_THRESHOLD (128)
+#define ALPHA_THRESHOLD (128)
+
+_Static_assert(sizeof(AtlasHeader_t) == 8, "atlas header must be tightly packed");
+_Static_assert(sizeof(AtlasEntry_t) == 16, "atlas entry must be tightly packed");
+
+typedef struct PackedSprite
+{
+    AtlasEntry_t entry;
+    uint8_t *data;
+    uint8_t *mask;
+} PackedSprite_t;
+
+static bool pack_png(const char *path, PackedSprite_t *out)
+{
+    png_image image;
+    uint8_t *rgba = NULL;
+    bool success = false;
+
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_file(&image, path))
+    {
+        fprintf(stderr, "assetpack: couldn't open %s: %s\n", path, image.message);
+        goto cleanup;
+    }
+
+    image.format = PNG_FORMAT_RGBA;
+    rgba = malloc(PNG_IMAGE_SIZE(image));
+
+    if (rgba == NULL)
+    {
+        fprintf(stderr, "assetpack: out of memory decoding %s\n", path);
+        goto cleanup;
+    }
+
+    if (!png_image_finish_read(&image, NULL, rgba, 0, NULL))
+    {
+        fprintf(stderr, "assetpack: couldn't decode %s: %s\n", path, image.message);
+        goto cleanup;
+    }
+
+    const uint32_t width = image.width;
+    const uint32_t height = image.height;
+    const uint32_t rowbytes = (width + 7) / 8;
+    bool has_transparency = false;
+
+    if (width > UINT16_MAX || height > UINT16_MAX)
+    {
+        fprintf(stderr, "assetpack: %s is too large (%ux%u)\n", path, width, height);
+        goto cleanup;
+    }
+
+    out->data = calloc(rowbytes * height, 1);
+    out->mask = calloc(rowbytes * height, 1);
+
+    if (out->data == NULL || out->mask == NULL)
+    {
+        fprintf(stderr, "assetpack: out of memory packing %s\n", path);
+        goto cleanup;
+    }
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const uint8_t *px = rgba + ((x + (y * width)) * 4);
+            const uint32_t luma = (px[0] * 299 + px[1] * 587 + px[2] * 114) / 1000;
+            const uint8_t bit = 0x80 >> (x % 8);
+
+            if (luma >= LUMA_THRESHOLD) out->data[(y * rowbytes) + (x / 8)] |= bit;
+
+            if (px[3] >= ALPHA_THRESHOLD) out->mask[(y * rowbytes) + (x / 8)] |= bit;
+            else has_transparency = true;
+        }
+    }
+
+    if (!has_transparency)
+    {
+        free(out->mask);
+        out->mask = NULL;
+    }
+
+    out->entry.width = width;
+    out->entry.height = height;
+    out->entry.rowbytes = rowbytes;
+    out->entry.flags = has_transparency ? ATLASFLAG_MASK : ATLASFLAG_NONE;
+    success = true;
+
+cleanup:
+    if (!success)
+    {
+        free(out->data);
+        free(out->mask);
+        out->data = NULL;
+        out->mask = NULL;
+    }
+
+    free(rgba);
+    png_image_free(&image);
+    return success;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <out.atlas> <in0.png> [in1.png ...]\n", argv[0]);
+        return 1;
+    }
+
+    const int count = argc - 2;
+
+    if (count > ATLAS_MAX_ENTRIES)
+    {
+        fprintf(stderr, "assetpack: too many sprites (%d > %d)\n", count, ATLAS_MAX_ENTRIES);
+        return 1;
+    }
+
+    PackedSprite_t *sprites = calloc(count, sizeof(PackedSprite_t));
+    FILE *file = NULL;
+    uint64_t offset = sizeof(AtlasHeader_t) + (count * sizeof(AtlasEntry_t));
+    int result = 1;
+
+    if (sprites == NULL)
+    {
+        fprintf(stderr, "assetpack: out of memory\n");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!pack_png(argv[i + 2], sprites + i)) goto cleanup;
+
+        const uint32_t plane_size = sprites[i].entry.rowbytes * sprites[i].entry.height;
+
+        sprites[i].entry.data_offset = offset;
+        offset += plane_size;
+
+        if (sprites[i].mask != NULL)
+        {
+            sprites[i].entry.mask_offset = offset;
+            offset += plane_size;
+        }
+
+        if (offset > UINT32_MAX)
+        {
+            fprintf(stderr, "assetpack: atlas outgrew 32 bit offsets at %s\n", argv[i + 2]);
+            goto cleanup;
+        }
+    }
+
+    file = fopen(argv[1], "wb");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "assetpack: couldn't open %s for writing\n", argv[1]);
+        goto cleanup;
+    }
+
+    AtlasHeader_t header = { .version = ATLAS_VERSION, .count = count };
+    memcpy(header.magic, ATLAS_MAGIC, sizeof(header.magic));
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (int i = 0; written && i < count; i++)
+    {
+        written = fwrite(&sprites[i].entry, sizeof(AtlasEntry_t), 1, file) == 1;
+    }
+
+    for (int i = 0; written && i < count; i++)
+    {
+        const uint32_t plane_size = sprites[i].entry.rowbytes * sprites[i].entry.height;
+        written = fwrite(sprites[i].data, plane_size, 1, file) == 1;
+        if (written && sprites[i].mask != NULL) written = fwrite(sprites[i].mask, plane_size, 1, file) == 1;
+    }
+
+    if (fclose(file) != 0) written = false;
+    file = NULL;
+
+    if (!written)
+    {
+        fprintf(stderr, "assetpack: couldn't write %s\n", argv[1]);
+        goto cleanup;
+    }
+
+    printf("assetpack: packed %d sprites into %s (%u bytes)\n", count, argv[1], (uint32_t)offset);
+    result = 0;
+
+cleanup:
+    if (file != NULL) fclose(file);
+
+    for (int i = 0; sprites != NULL && i < count; i++)
+    {
+        free(sprites[i].data);
+        free(sprites[i].mask);
+    }
+
+    free(sprites);
+    return result;
+}
@@ -0,0 +1,123 @@
+/**
+ * Host-side determinism checker.
+ * Compares two per-tick hash logs written by REPLAY_MODE builds (see src/replay_format.h),
+ * typically a recording from a known good build against a playback of the same input by a changed one,
+ * and reports the first tick where each simulation subsystem diverged.
+ * Exits with 0 when the logs match tick for tick, 1 when they don't.
+ *
+ * usage: hashdiff <expected.bin> <actual.bin>
+ **/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/replay_format.h"
+
+#define TICK_NONE (0xFFFFFFFF)
+
+static const char *subsystem_names[HASH_SUBSYSTEM_COUNT] =
+{
+    "level",
+    "global entities",
+    "rooms",
+    "generation",
+};
+
+static FILE *open_log(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    ReplayHashHeader_t header;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "hashdiff: couldn't open %s\n", path);
+        return NULL;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1
+     || memcmp(header.magic, REPLAY_HASH_MAGIC, sizeof(header.magic)) != 0
+     || header.version != REPLAY_VERSION || header.subsystem_count != HASH_SUBSYSTEM_COUNT)
+    {
+        fprintf(stderr, "hashdiff: %s isn't a version %d hash log\n", path, REPLAY_VERSION);
+        fclose(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: hashdiff <expected.bin> <actual.bin>\n");
+        return 2;
+    }
+
+    FILE *expected = open_log(argv[1]);
+    FILE *actual = open_log(argv[2]);
+
+    if (expected == NULL || actual == NULL) return 2;
+
+    ReplayHashRecord_t expected_record;
+    ReplayHashRecord_t actual_record;
+    uint32_t first_diverged[HASH_SUBSYSTEM_COUNT];
+    uint32_t diverged_ticks[HASH_SUBSYSTEM_COUNT] = {0};
+    uint32_t tick_count = 0;
+    bool matched = true;
+
+    memset(first_diverged, 0xFF, sizeof(first_diverged));
+
+    while (true)
+    {
+        const bool has_expected = fread(&expected_record, sizeof(expected_record), 1, expected) == 1;
+        const bool has_actual = fread(&actual_record, sizeof(actual_record), 1, actual) == 1;
+
+        if (!has_expected || !has_actual)
+        {
+            if (has_expected != has_actual)
+            {
+                matched = false;
+                printf("length: %s ends at tick %u, the other log goes on\n", has_expected ? argv[2] : argv[1], tick_count);
+            }
+            break;
+        }
+
+        for (int i = 0; i < HASH_SUBSYSTEM_COUNT; i++)
+        {
+            if (expected_record.hashes[i] == actual_record.hashes[i]) continue;
+
+            matched = false;
+            diverged_ticks[i]++;
+
+            if (first_diverged[i] != TICK_NONE) continue;
+
+            first_diverged[i] = expected_record.tick;
+            printf("tick %u: %s diverged (%08x expected, %08x actual)\n",
+                    expected_record.tick, subsystem_names[i], expected_record.hashes[i], actual_record.hashes[i]);
+        }
+
+        tick_count++;
+    }
+
+    fclose(expected);
+    fclose(actual);
+
+    if (matched)
+    {
+        printf("hashdiff: %u ticks match\n", tick_count);
+        return 0;
+    }
+
+    printf("hashdiff: %u ticks compared\n", tick_count);
+
+    for (int i = 0; i < HASH_SUBSYSTEM_COUNT; i++)
+    {
+        if (first_diverged[i] == TICK_NONE) continue;
+        printf("  %-16s first diverged at tick %u, differs on %u ticks\n", subsystem_names[i], first_diverged[i], diverged_ticks[i]);
+    }
+
+    return 1;
+}
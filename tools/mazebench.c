@@ -0,0 +1,195 @@
+/**
+ * Host-side room generator benchmark.
+ * Runs every generator in src/room_gen.c over the same seeds and door layouts and reports
+ * generation time, scratch memory high water, dead ends, shortest path length between doors and door reachability.
+ *
+ * usage: mazebench [room_count] [first_seed]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/room_gen.h"
+
+#define DEFAULT_ROOM_COUNT (100000)
+
+typedef struct BenchResult
+{
+    double total_ns;
+    uint64_t dead_ends;
+    uint64_t open_cells;
+    uint64_t path_length_sum;
+    uint64_t path_count;
+    uint64_t rooms_connected;
+    uint64_t rooms_failed;
+    uint32_t scratch_high_water;
+} BenchResult_t;
+
+static const int dir_dx[4] = { -1, 0, 1, 0 };
+static const int dir_dy[4] = { 0, -1, 0, 1 };
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static bool cell_open(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], int x, int y)
+{
+    return x >= ROOM_MIN_X && x <= ROOM_MAX_X && y >= ROOM_MIN_Y && y <= ROOM_MAX_Y
+        && cell_grid[x][y] >= CELL_PATH_0;
+}
+
+// breadth first distances from one cell, -1 where unreachable
+static void distances_from(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], Vector2Int_t start, int dist[ROOM_WIDTH][ROOM_HEIGHT])
+{
+    Vector2Int_t queue[ROOM_WIDTH*ROOM_HEIGHT];
+    int head = 0;
+    int tail = 0;
+
+    memset(dist, -1, sizeof(int) * ROOM_WIDTH * ROOM_HEIGHT);
+    if (!cell_open(cell_grid, start.x, start.y)) return;
+
+    dist[start.x][start.y] = 0;
+    queue[tail++] = start;
+
+    while (head < tail)
+    {
+        const Vector2Int_t curr = queue[head++];
+
+        for (int i = 0; i < 4; i++)
+        {
+            const int x = curr.x + dir_dx[i];
+            const int y = curr.y + dir_dy[i];
+
+            if (!cell_open(cell_grid, x, y) || dist[x][y] >= 0) continue;
+
+            dist[x][y] = dist[curr.x][curr.y] + 1;
+            queue[tail++] = (Vector2Int_t){x, y};
+        }
+    }
+}
+
+static void measure_room(CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT], const bool door_bools[4], BenchResult_t *result)
+{
+    static int dist[ROOM_WIDTH][ROOM_HEIGHT];
+    bool connected = true;
+
+    for (int x = ROOM_MIN_X; x <= ROOM_MAX_X; x++)
+    {
+        for (int y = ROOM_MIN_Y; y <= ROOM_MAX_Y; y++)
+        {
+            if (!cell_open(cell_grid, x, y)) continue;
+
+            int neighbours = 0;
+            for (int i = 0; i < 4; i++) neighbours += cell_open(cell_grid, x + dir_dx[i], y + dir_dy[i]);
+
+            result->open_cells++;
+
+            // path starts lead out through their door, so they don't count as dead ends
+            bool is_start = false;
+            for (int door = 0; door < 4; door++)
+            {
+                if (door_bools[door] && room_path_starts[door].x == x && room_path_starts[door].y == y) is_start = true;
+            }
+
+            if (neighbours <= 1 && !is_start) result->dead_ends++;
+        }
+    }
+
+    for (int from = 0; from < 4; from++)
+    {
+        if (!door_bools[from]) continue;
+
+        distances_from(cell_grid, room_path_starts[from], dist);
+
+        for (int to = from + 1; to < 4; to++)
+        {
+            if (!door_bools[to]) continue;
+
+            const int d = dist[room_path_starts[to].x][room_path_starts[to].y];
+
+            if (d < 0)
+            {
+                connected = false;
+                continue;
+            }
+
+            result->path_length_sum += d;
+            result->path_count++;
+        }
+    }
+
+    result->rooms_connected += connected;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t room_count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ROOM_COUNT;
+    const uint32_t first_seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+    static CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT];
+    static uint8_t scratch_memory[ROOM_GEN_SCRATCH_BYTES];
+    BenchResult_t results[ROOMGEN_COUNT] = {0};
+    Arena_t scratch;
+
+    for (int gen = 0; gen < ROOMGEN_COUNT; gen++)
+    {
+        arena_init(&scratch, "scratch", scratch_memory, sizeof(scratch_memory));
+
+        for (uint32_t i = 0; i < room_count; i++)
+        {
+            const uint32_t seed = first_seed + i;
+
+            // most rooms have all four doors, level edges drop some
+            const uint32_t layout = hash_u32(~seed);
+            const uint8_t door_mask = (layout % 16) == 0 ? 1 + ((layout >> 4) % 15) : 0xF;
+            const bool door_bools[4] =
+            {
+                (door_mask & 0x1) != 0,
+                (door_mask & 0x2) != 0,
+                (door_mask & 0x4) != 0,
+                (door_mask & 0x8) != 0,
+            };
+
+            const double start = now_ns();
+            const bool success = room_generators[gen].generate(seed, door_bools, cell_grid, &scratch);
+            results[gen].total_ns += now_ns() - start;
+
+            if (!success)
+            {
+                results[gen].rooms_failed++;
+                continue;
+            }
+
+            measure_room(cell_grid, door_bools, results + gen);
+        }
+
+        results[gen].scratch_high_water = scratch.high_water;
+    }
+
+    printf("mazebench: %u rooms per generator, seeds %u..%u\n\n", room_count, first_seed, first_seed + room_count - 1);
+    printf("%-12s %10s %10s %10s %10s %12s %12s %8s\n",
+            "generator", "ns/room", "scratch", "open", "dead ends", "door path", "reachable", "failed");
+
+    for (int gen = 0; gen < ROOMGEN_COUNT; gen++)
+    {
+        const BenchResult_t *result = results + gen;
+        const uint32_t generated = room_count - result->rooms_failed;
+
+        printf("%-12s %10.0f %10u %10.1f %10.2f %12.2f %11.2f%% %8lu\n",
+                room_generators[gen].name,
+                result->total_ns / room_count,
+                result->scratch_high_water,
+                generated ? (double)result->open_cells / generated : 0.0,
+                generated ? (double)result->dead_ends / generated : 0.0,
+                result->path_count ? (double)result->path_length_sum / result->path_count : 0.0,
+                generated ? (100.0 * result->rooms_connected) / generated : 0.0,
+                (unsigned long)result->rooms_failed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+/**
+ * Host-side room generation fuzzer.
+ * Generates rooms for a range of seeds on every core (each thread takes a contiguous slice of the range),
+ * builds their tiles and checks them:
+ *   - the generator succeeds and leaves no unresolved cells
+ *   - tiles come out the same whatever the tile buffer held before
+ *   - tile flags agree with tile bitmaps, and door flags only appear on enabled door tiles
+ *   - every enabled door is reachable from every other one over walkable tiles
+ * Reports throughput and the lowest failing seed for each check.
+ *
+ * usage: mazefuzz [room_count] [first_seed] [generator_idx|-1 for all] [thread_count]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../src/room_gen.h"
+
+#define DEFAULT_ROOM_COUNT (1000000)
+#define THREADS_MAX (256)
+#define SEED_NONE (0xFFFFFFFF)
+
+typedef enum FuzzCheck
+{
+    FUZZ_GENERATE = 0,
+    FUZZ_UNRESOLVED = 1,
+    FUZZ_STALE_TILE = 2,
+    FUZZ_TILE_FLAGS = 3,
+    FUZZ_DOOR_REACH = 4,
+    FUZZ_CHECK_COUNT = 5,
+} FuzzCheck_t;
+
+typedef struct FuzzJob
+{
+    const RoomGenerator_t *generator;
+    Arena_t scratch;
+    uint8_t scratch_memory[ROOM_GEN_SCRATCH_BYTES];
+    uint32_t first_seed;
+    uint32_t seed_count;
+    uint64_t failures[FUZZ_CHECK_COUNT];
+    uint32_t min_failing_seed[FUZZ_CHECK_COUNT];
+} FuzzJob_t;
+
+static const char *check_names[FUZZ_CHECK_COUNT] =
+{
+    "generate",
+    "unresolved cell",
+    "stale tile",
+    "tile flags",
+    "door reach",
+};
+
+static const int dir_dx[4] = { -1, 0, 1, 0 };
+static const int dir_dy[4] = { 0, -1, 0, 1 };
+
+// the outermost tile of each door, indexed by Direction_t
+static const int door_tiles[4] =
+{
+    ROOM_MIN_X + (ROOM_WIDTH*ROOM_MID_Y),
+    ROOM_MID_X + (ROOM_WIDTH*ROOM_MIN_Y),
+    ROOM_MAX_X + (ROOM_WIDTH*ROOM_MID_Y),
+    ROOM_MID_X + (ROOM_WIDTH*ROOM_MAX_Y),
+};
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+// same layout distribution as tools/mazebench.c: mostly four doors, some edge rooms
+static void door_layout(uint32_t seed, bool door_bools[4])
+{
+    const uint32_t layout = hash_u32(~seed);
+    const uint8_t door_mask = (layout % 16) == 0 ? 1 + ((layout >> 4) % 15) : 0xF;
+
+    for (int door = 0; door < 4; door++) door_bools[door] = (door_mask & (1 << door)) != 0;
+}
+
+static bool tile_flags_valid(const Tile_t *tile, int tile_idx, const bool door_bools[4])
+{
+    switch(tile->bitmap_idx)
+    {
+        case BITMAP_FLOOR_00:
+        case BITMAP_FLOOR_01:
+        case BITMAP_FLOOR_02:
+        case BITMAP_FLOOR_03:
+            return tile->flags == TILEFLAG_WALKABLE;
+        case BITMAP_WALL:
+        case BITMAP_TABLE:
+        case BITMAP_CRATE:
+            return tile->flags == TILEFLAG_NONE;
+        case BITMAP_DOOR_H:
+            return tile->flags == (TILEFLAG_DOOR_H | TILEFLAG_WALKABLE)
+                && ((tile_idx == door_tiles[DIR_LEFT] && door_bools[DIR_LEFT])
+                 || (tile_idx == door_tiles[DIR_RIGHT] && door_bools[DIR_RIGHT]));
+        case BITMAP_DOOR_V:
+            return tile->flags == (TILEFLAG_DOOR_V | TILEFLAG_WALKABLE)
+                && ((tile_idx == door_tiles[DIR_UP] && door_bools[DIR_UP])
+                 || (tile_idx == door_tiles[DIR_DOWN] && door_bools[DIR_DOWN]));
+        default:
+            return false;
+    }
+}
+
+static bool doors_connected(const Tile_t tiles[ROOM_WIDTH*ROOM_HEIGHT], const bool door_bools[4])
+{
+    bool visited[ROOM_WIDTH*ROOM_HEIGHT] = {0};
+    uint16_t queue[ROOM_WIDTH*ROOM_HEIGHT];
+    uint16_t head = 0;
+    uint16_t tail = 0;
+
+    for (int door = 0; door < 4 && tail == 0; door++)
+    {
+        if (!door_bools[door]) continue;
+        visited[door_tiles[door]] = true;
+        queue[tail++] = door_tiles[door];
+    }
+
+    while (head < tail)
+    {
+        const int x = queue[head] % ROOM_WIDTH;
+        const int y = queue[head] / ROOM_WIDTH;
+        head++;
+
+        for (int i = 0; i < 4; i++)
+        {
+            const int next_x = x + dir_dx[i];
+            const int next_y = y + dir_dy[i];
+
+            if (next_x < ROOM_MIN_X || next_x > ROOM_MAX_X || next_y < ROOM_MIN_Y || next_y > ROOM_MAX_Y) continue;
+
+            const uint16_t next_idx = next_x + (next_y * ROOM_WIDTH);
+            if (visited[next_idx] || !(tiles[next_idx].flags & TILEFLAG_WALKABLE)) continue;
+
+            visited[next_idx] = true;
+            queue[tail++] = next_idx;
+        }
+    }
+
+    for (int door = 0; door < 4; door++)
+    {
+        if (door_bools[door] && !visited[door_tiles[door]]) return false;
+    }
+
+    return true;
+}
+
+static void fail(FuzzJob_t *job, FuzzCheck_t check, uint32_t seed)
+{
+    job->failures[check]++;
+    if (seed < job->min_failing_seed[check]) job->min_failing_seed[check] = seed;
+}
+
+static void *fuzz_worker(void *arg)
+{
+    FuzzJob_t *job = arg;
+    CellType_t cell_grid[ROOM_WIDTH][ROOM_HEIGHT];
+    Tile_t tiles[ROOM_WIDTH*ROOM_HEIGHT];
+    Tile_t stale_tiles[ROOM_WIDTH*ROOM_HEIGHT];
+    bool door_bools[4];
+
+    arena_init(&job->scratch, "scratch", job->scratch_memory, sizeof(job->scratch_memory));
+
+    for (uint32_t i = 0; i < job->seed_count; i++)
+    {
+        const uint32_t seed = job->first_seed + i;
+        door_layout(seed, door_bools);
+
+        if (!job->generator->generate(seed, door_bools, cell_grid, &job->scratch))
+        {
+            fail(job, FUZZ_GENERATE, seed);
+            continue;
+        }
+
+        // the game builds into a zeroed room, rebuilding over leftovers must give the same tiles
+        memset(tiles, 0, sizeof(tiles));
+        memset(stale_tiles, 0xA5, sizeof(stale_tiles));
+
+        if (!build_room_tiles(cell_grid, door_bools, tiles)) fail(job, FUZZ_UNRESOLVED, seed);
+        build_room_tiles(cell_grid, door_bools, stale_tiles);
+
+        if (memcmp(tiles, stale_tiles, sizeof(tiles)) != 0) fail(job, FUZZ_STALE_TILE, seed);
+
+        for (int tile_idx = 0; tile_idx < ROOM_WIDTH*ROOM_HEIGHT; tile_idx++)
+        {
+            if (!tile_flags_valid(tiles+tile_idx, tile_idx, door_bools))
+            {
+                fail(job, FUZZ_TILE_FLAGS, seed);
+                break;
+            }
+        }
+
+        if (!doors_connected(tiles, door_bools)) fail(job, FUZZ_DOOR_REACH, seed);
+    }
+
+    return NULL;
+}
+
+static bool fuzz_generator(const RoomGenerator_t *generator, uint32_t first_seed, uint32_t room_count, int thread_count)
+{
+    static FuzzJob_t jobs[THREADS_MAX];
+    static pthread_t threads[THREADS_MAX];
+
+    const uint32_t slice = (room_count + thread_count - 1) / thread_count;
+    const double start = now_sec();
+
+    for (int t = 0; t < thread_count; t++)
+    {
+        const uint32_t offset = slice * t;
+
+        memset(jobs+t, 0, sizeof(FuzzJob_t));
+        memset(jobs[t].min_failing_seed, 0xFF, sizeof(jobs[t].min_failing_seed));
+        jobs[t].generator = generator;
+        jobs[t].first_seed = first_seed + offset;
+        jobs[t].seed_count = offset >= room_count ? 0 : (room_count - offset < slice ? room_count - offset : slice);
+
+        pthread_create(threads+t, NULL, fuzz_worker, jobs+t);
+    }
+
+    uint64_t failures[FUZZ_CHECK_COUNT] = {0};
+    uint32_t min_failing_seed[FUZZ_CHECK_COUNT];
+    memset(min_failing_seed, 0xFF, sizeof(min_failing_seed));
+
+    for (int t = 0; t < thread_count; t++)
+    {
+        pthread_join(threads[t], NULL);
+
+        for (int c = 0; c < FUZZ_CHECK_COUNT; c++)
+        {
+            failures[c] += jobs[t].failures[c];
+            if (jobs[t].min_failing_seed[c] < min_failing_seed[c]) min_failing_seed[c] = jobs[t].min_failing_seed[c];
+        }
+    }
+
+    const double elapsed = now_sec() - start;
+    bool passed = true;
+
+    printf("%-12s %u rooms in %.2fs (%.0f rooms/s)\n", generator->name, room_count, elapsed, room_count / elapsed);
+
+    for (int c = 0; c < FUZZ_CHECK_COUNT; c++)
+    {
+        if (failures[c] == 0) continue;
+
+        passed = false;
+        printf("  FAIL %-16s %10lu rooms, lowest seed %u\n", check_names[c], (unsigned long)failures[c], min_failing_seed[c]);
+    }
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t room_count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ROOM_COUNT;
+    const uint32_t first_seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+    const int generator_idx = argc > 3 ? atoi(argv[3]) : -1;
+    int thread_count = argc > 4 ? atoi(argv[4]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > THREADS_MAX) thread_count = THREADS_MAX;
+
+    if (generator_idx >= ROOMGEN_COUNT)
+    {
+        fprintf(stderr, "mazefuzz: no generator #%d (%d available)\n", generator_idx, ROOMGEN_COUNT);
+        return 1;
+    }
+
+    printf("mazefuzz: seeds %u..%u on %d threads\n", first_seed, first_seed + room_count - 1, thread_count);
+
+    bool passed = true;
+
+    for (int gen = 0; gen < ROOMGEN_COUNT; gen++)
+    {
+        if (generator_idx >= 0 && gen != generator_idx) continue;
+        passed &= fuzz_generator(room_generators + gen, first_seed, room_count, thread_count);
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/**
+ * Host-side trace decoder.
+ * Converts a binary trace dumped by the game (see src/trace.h) into Chrome trace event JSON,
+ * viewable in chrome://tracing or Perfetto:
+ *   - frames become back-to-back slices on the game track
+ *   - room generation becomes slices on the generation track, walk links and dead ends instants on it
+ *   - room entries and collisions become instants on the game track
+ *
+ * usage: tracedecode <trace.bin> [out.json]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/geometry.h"
+#include "../src/trace.h"
+
+#define TRACK_GAME (1)
+#define TRACK_GENERATION (2)
+
+static const char *event_names[TRACE_EVENT_TYPE_COUNT] =
+{
+    "frame",
+    "room entered",
+    "room generated",
+    "walk link",
+    "walk dead end",
+    "collision",
+};
+
+// coordinates are packed as two bytes, tiles just outside a room come out negative
+static int coord_x(uint16_t coord)
+{
+    return (int8_t)(coord & 0xFF);
+}
+
+static int coord_y(uint16_t coord)
+{
+    return (int8_t)(coord >> 8);
+}
+
+static void print_instant(FILE *out, const TraceEvent_t *event, uint64_t ts, int track)
+{
+    fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":%d,\"args\":{",
+            event_names[event->type], (unsigned long long)ts, track);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: tracedecode <trace.bin> [out.json]\n");
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        fprintf(stderr, "tracedecode: couldn't open %s\n", argv[1]);
+        return 1;
+    }
+
+    TraceHeader_t header;
+
+    if (fread(&header, sizeof(header), 1, in) != 1
+     || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+     || header.version != TRACE_VERSION || header.event_size != sizeof(TraceEvent_t))
+    {
+        fprintf(stderr, "tracedecode: %s isn't a version %d trace\n", argv[1], TRACE_VERSION);
+        fclose(in);
+        return 1;
+    }
+
+    TraceEvent_t *events = calloc(header.count > 0 ? header.count : 1, sizeof(TraceEvent_t));
+    const uint32_t count = fread(events, sizeof(TraceEvent_t), header.count, in);
+    fclose(in);
+
+    if (count < header.count) fprintf(stderr, "tracedecode: %s is truncated, %u of %u events\n", argv[1], count, header.count);
+
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "tracedecode: couldn't open %s\n", argv[2]);
+        free(events);
+        return 1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"overwritten\":%u},\"traceEvents\":[\n", header.overwritten);
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"game\"}}", TRACK_GAME);
+    fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"generation\"}}", TRACK_GENERATION);
+
+    // the game's microsecond clock is 32 bits, widen it so a wrap doesn't run time backwards
+    uint64_t ts = count > 0 ? events[0].time_us : 0;
+    uint32_t prev_time = ts;
+    uint32_t unknown = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const TraceEvent_t *event = events+i;
+
+        ts += (uint32_t)(event->time_us - prev_time);
+        prev_time = event->time_us;
+
+        switch(event->type)
+        {
+            case TRACE_FRAME:
+            {
+                // a frame lasts until the next one starts, the last one has nothing to end it
+                uint32_t next = i + 1;
+                while (next < count && events[next].type != TRACE_FRAME) next++;
+                if (next >= count) break;
+
+                fprintf(out, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%d,\"args\":{\"index\":%u}}",
+                        (unsigned long long)ts, (uint32_t)(events[next].time_us - event->time_us), TRACK_GAME, event->arg1);
+                break;
+            }
+            case TRACE_ROOM_ENTERED:
+                print_instant(out, event, ts, TRACK_GAME);
+                fprintf(out, "\"room\":%u,\"x\":%d,\"y\":%d,\"floor\":%u}}",
+                        event->arg0, room_idx_x(event->arg0), room_idx_y(event->arg0), event->arg1);
+                break;
+            case TRACE_ROOM_GENERATED:
+                fprintf(out, ",\n{\"name\":\"room generated\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%d,"
+                        "\"args\":{\"room\":%u,\"x\":%d,\"y\":%d}}",
+                        (unsigned long long)(ts - (event->arg1 < ts ? event->arg1 : ts)), event->arg1, TRACK_GENERATION,
+                        event->arg0, room_idx_x(event->arg0), room_idx_y(event->arg0));
+                break;
+            case TRACE_WALK_LINK:
+            case TRACE_WALK_DEAD_END:
+                print_instant(out, event, ts, TRACK_GENERATION);
+                fprintf(out, "\"x\":%d,\"y\":%d,\"path\":%u}}", coord_x(event->arg0), coord_y(event->arg0), event->arg1);
+                break;
+            case TRACE_COLLISION:
+                print_instant(out, event, ts, TRACK_GAME);
+                fprintf(out, "\"tile_x\":%d,\"tile_y\":%d,\"global\":%u}}", coord_x(event->arg0), coord_y(event->arg0), event->arg1);
+                break;
+            default:
+                unknown++;
+                break;
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "tracedecode: %u events, %u overwritten before the dump, %u of unknown type\n", count, header.overwritten, unknown);
+
+    free(events);
+    return 0;
+}
@@ -0,0 +1,6 @@
+mkdir -p build/tools
+# host-side diagnostics, these share generation code with the game but never ship with it
+cc -O2 -Wall -o build/tools/mazebench tools/mazebench.c src/room_gen.c src/arena.c
+cc -O2 -Wall -pthread -o build/tools/mazefuzz tools/mazefuzz.c src/room_gen.c src/arena.c
+cc -O2 -Wall -o build/tools/tracedecode tools/tracedecode.c
+cc -O2 -Wall -o build/tools/hashdiff tools/hashdiff.c